@@ -1,6 +1,6 @@
 #include "ActiveObject.h"
 
-ActiveObject::ActiveObject() : done(false) {
+ActiveObject::ActiveObject() : done(false), pending(0), agingStep(500) {
     th = std::thread(&ActiveObject::run, this);
 }
 
@@ -8,9 +8,28 @@ ActiveObject::~ActiveObject() {
     stop();
 }
 
+ActiveObject::Lane ActiveObject::laneFor(size_t cost) {
+    if (cost <= 100000)
+        return Lane::INTERACTIVE;
+    if (cost <= 10000000)
+        return Lane::NORMAL;
+    return Lane::BATCH;
+}
+
 void ActiveObject::send(std::function<void()> msg) {
+    send(std::move(msg), 0);
+}
+
+void ActiveObject::send(std::function<void()> msg, size_t cost) {
+    send(std::move(msg), cost, nullptr);
+}
+
+void ActiveObject::send(std::function<void()> msg, size_t cost, std::shared_ptr<const CancellationToken> token,
+                        std::function<void()> dropped) {
     std::lock_guard<std::mutex> lock(mtx);
-    q.push(std::move(msg));
+    lanes[static_cast<size_t>(laneFor(cost))].push_back({std::move(msg), std::chrono::steady_clock::now(), std::move(token),
+                                                         std::move(dropped), Trace::currentRequest()});
+    pending++;
     cv.notify_one();
 }
 
@@ -24,18 +43,56 @@ void ActiveObject::stop() {
     }
 }
 
+ActiveObject::Message ActiveObject::next() {
+    auto now = std::chrono::steady_clock::now();
+
+    // Aged heads first, oldest wins
+    size_t chosen = lanes.size();
+    for (size_t lane = 1; lane < lanes.size(); ++lane) {
+        if (lanes[lane].empty())
+            continue;
+        const Message& head = lanes[lane].front();
+        if (now - head.enqueued < agingStep * lane)
+            continue;
+        if (chosen == lanes.size() || head.enqueued < lanes[chosen].front().enqueued)
+            chosen = lane;
+    }
+
+    // Otherwise the highest non-empty lane
+    if (chosen == lanes.size()) {
+        for (chosen = 0; lanes[chosen].empty(); ++chosen) {}
+    }
+
+    Message msg = std::move(lanes[chosen].front());
+    lanes[chosen].pop_front();
+    pending--;
+    if (msg.token && msg.token->isCancelled())
+        msg.fn = nullptr;
+    return msg;
+}
+
 void ActiveObject::run() {
+    Trace::setThreadName("active object");
     while (true) {
-        std::function<void()> msg;
+        Message msg;
         {
             std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [this]() { return !q.empty() || done; });
-            if (done && q.empty()) break;
-            if (!q.empty()) {
-                msg = std::move(q.front());
-                q.pop();
+            cv.wait(lock, [this]() { return pending > 0 || done; });
+            if (done && pending == 0) break;
+            if (pending > 0) {
+                msg = next();
             }
         }
-        if (msg) msg();
+        if (!msg.fn) {
+            if (msg.dropped)
+                msg.dropped();
+            continue;
+        }
+        // Time spent waiting in a lane shows up on the sender's request track
+        if (msg.request && Trace::isEnabled())
+            Trace::record("ao.queued", "request", msg.enqueued, Trace::Clock::now(), nullptr, 0, msg.request);
+        Trace::RequestScope scope(msg.request);
+        TraceSpan span("ao.run", "active_object", "request", static_cast<long long>(msg.request));
+        msg.fn();
     }
-}
\ No newline at end of file
+}
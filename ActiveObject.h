@@ -4,25 +4,55 @@
 
 #include <functional>
 #include <thread>
-#include <queue>
+#include <deque>
+#include <array>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
+#include "CancellationToken.h"
+#include "Trace.h"
 
 class ActiveObject {
 public:
+    // Priority lanes, highest first. A message's lane comes from its estimated cost.
+    enum class Lane { INTERACTIVE, NORMAL, BATCH };
+
     ActiveObject();
     ~ActiveObject();
 
+    // Untagged messages (mutations, bookkeeping) run in the interactive lane
     void send(std::function<void()> msg);
+    // cost is a rough count of elementary steps the message will take
+    void send(std::function<void()> msg, size_t cost);
+    // Messages whose token has fired by the time they reach the front are dropped
+    // unrun; dropped, if set, runs in their place so their waiters hear of it
+    void send(std::function<void()> msg, size_t cost, std::shared_ptr<const CancellationToken> token,
+              std::function<void()> dropped = nullptr);
     void stop();
 
+    static Lane laneFor(size_t cost);
+
 private:
+    struct Message {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point enqueued;
+        std::shared_ptr<const CancellationToken> token;
+        std::function<void()> dropped; // Runs instead of fn once token has fired
+        uint64_t request; // Trace request of the sender, run under the same id
+    };
+
     void run();
+    Message next(); // Called with mtx held and at least one message queued; fn is empty if it was cancelled
 
     std::thread th;
     std::atomic<bool> done;
-    std::queue<std::function<void()>> q;
+    std::array<std::deque<Message>, 3> lanes;
+    size_t pending;
+    // A message that waited agingStep per lane below INTERACTIVE is served next
+    // regardless of its lane, so batch work cannot starve
+    std::chrono::milliseconds agingStep;
     std::mutex mtx;
     std::condition_variable cv;
 };
@@ -0,0 +1,27 @@
+#include "CancellationToken.h"
+
+CancellationToken::CancellationToken()
+    : cancelled(false), deadline(Clock::time_point::max().time_since_epoch().count()) {}
+
+void CancellationToken::cancel() {
+    cancelled.store(true, std::memory_order_release);
+}
+
+void CancellationToken::setDeadline(Clock::time_point when) {
+    deadline.store(when.time_since_epoch().count(), std::memory_order_release);
+}
+
+CancellationToken::Clock::time_point CancellationToken::getDeadline() const {
+    return Clock::time_point(Clock::duration(deadline.load(std::memory_order_acquire)));
+}
+
+bool CancellationToken::isCancelled() const {
+    if (cancelled.load(std::memory_order_acquire))
+        return true;
+    return Clock::now().time_since_epoch().count() >= deadline.load(std::memory_order_acquire);
+}
+
+void CancellationToken::throwIfCancelled() const {
+    if (isCancelled())
+        throw OperationCancelled();
+}
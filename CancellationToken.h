@@ -0,0 +1,36 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+
+// Thrown from cooperative cancellation points once a token fires
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled() : std::runtime_error("operation cancelled") {}
+};
+
+// Shared flag checked by queued and running work. A token fires when it is
+// cancelled explicitly or when its deadline passes.
+class CancellationToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CancellationToken();
+
+    void cancel();
+    // Clock::time_point::max() means no deadline
+    void setDeadline(Clock::time_point deadline);
+    Clock::time_point getDeadline() const;
+
+    bool isCancelled() const;
+    void throwIfCancelled() const;
+
+private:
+    std::atomic<bool> cancelled;
+    std::atomic<int64_t> deadline; // Clock ticks since epoch
+};
+
+#endif // CANCELLATION_TOKEN_H
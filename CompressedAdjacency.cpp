@@ -0,0 +1,84 @@
+#include "CompressedAdjacency.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+}
+
+CompressedAdjacency::CompressedAdjacency(int vertices, const std::vector<std::tuple<int, int, int>>& edges, bool directed)
+    : idOffset(vertices + 1, 0), entryOffset(vertices + 1, 0), weightWidth(1), minWeight(0) {
+    if (!edges.empty()) {
+        int maxWeight = std::get<2>(edges[0]);
+        minWeight = maxWeight;
+        for (const auto& edge : edges) {
+            minWeight = std::min(minWeight, std::get<2>(edge));
+            maxWeight = std::max(maxWeight, std::get<2>(edge));
+        }
+        uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(maxWeight) - minWeight);
+        weightWidth = range <= UINT8_MAX ? 1 : range <= UINT16_MAX ? 2 : 4;
+    }
+
+    // Counting sort of the entries by vertex
+    for (const auto& edge : edges) {
+        entryOffset[std::get<0>(edge) + 1]++;
+        if (!directed)
+            entryOffset[std::get<1>(edge) + 1]++;
+    }
+    for (int u = 0; u < vertices; ++u)
+        entryOffset[u + 1] += entryOffset[u];
+    std::vector<std::pair<int, int>> entries(entryOffset[vertices]);
+    std::vector<uint64_t> fill(entryOffset.begin(), entryOffset.end() - 1);
+    for (const auto& edge : edges) {
+        int u = std::get<0>(edge), v = std::get<1>(edge), w = std::get<2>(edge);
+        entries[fill[u]++] = {v, w};
+        if (!directed)
+            entries[fill[v]++] = {u, w};
+    }
+    fill.clear();
+    fill.shrink_to_fit();
+
+    weights.resize(entries.size() * weightWidth);
+    ids.reserve(entries.size() + vertices);
+    uint8_t* w = weights.data();
+    for (int u = 0; u < vertices; ++u) {
+        auto first = entries.begin() + entryOffset[u];
+        auto last = entries.begin() + entryOffset[u + 1];
+        std::sort(first, last);
+        int previous = u;
+        for (auto it = first; it != last; ++it) {
+            if (it == first) {
+                int32_t delta = it->first - u;
+                writeVarint(ids, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+            } else {
+                writeVarint(ids, static_cast<uint32_t>(it->first - previous));
+            }
+            previous = it->first;
+
+            uint32_t offset = static_cast<uint32_t>(static_cast<int64_t>(it->second) - minWeight);
+            if (weightWidth == 1) {
+                *w = static_cast<uint8_t>(offset);
+            } else if (weightWidth == 2) {
+                uint16_t narrow = static_cast<uint16_t>(offset);
+                std::memcpy(w, &narrow, sizeof(narrow));
+            } else {
+                std::memcpy(w, &offset, sizeof(offset));
+            }
+            w += weightWidth;
+        }
+        idOffset[u + 1] = ids.size();
+    }
+    ids.shrink_to_fit();
+}
+
+size_t CompressedAdjacency::getBytes() const {
+    return ids.capacity() + weights.capacity() + (idOffset.capacity() + entryOffset.capacity()) * sizeof(uint64_t);
+}
@@ -0,0 +1,72 @@
+#ifndef COMPRESSED_ADJACENCY_H
+#define COMPRESSED_ADJACENCY_H
+
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Read-only adjacency for large graphs, built from an edge list in one pass.
+// Each vertex's neighbours are sorted and stored as LEB128 varint gaps (the
+// first one zigzag-encoded relative to the vertex itself, so local edges take
+// one byte), and weights as offsets from the smallest weight in 1, 2 or 4 bytes
+// depending on the range. Vertices are 0-based; undirected graphs list every
+// edge at both ends, directed ones at the source only.
+class CompressedAdjacency {
+public:
+    CompressedAdjacency(int vertices, const std::vector<std::tuple<int, int, int>>& edges, bool directed);
+
+    int getVertices() const { return static_cast<int>(idOffset.size()) - 1; }
+    size_t getEntryCount() const { return entryOffset.back(); }
+    // Heap bytes held by the encoding
+    size_t getBytes() const;
+    int degree(int u) const { return static_cast<int>(entryOffset[u + 1] - entryOffset[u]); }
+
+    // Calls fn(v, weight) for every neighbour of u in increasing order of v
+    template <typename Fn>
+    void forEachNeighbor(int u, Fn&& fn) const {
+        switch (weightWidth) {
+        case 1: decode<uint8_t>(u, fn); break;
+        case 2: decode<uint16_t>(u, fn); break;
+        default: decode<uint32_t>(u, fn); break;
+        }
+    }
+
+private:
+    template <typename W, typename Fn>
+    void decode(int u, Fn& fn) const {
+        const uint8_t* p = ids.data() + idOffset[u];
+        const uint8_t* end = ids.data() + idOffset[u + 1];
+        const uint8_t* w = weights.data() + entryOffset[u] * sizeof(W);
+        if (p == end)
+            return;
+        uint32_t gap = readVarint(p);
+        int v = u + static_cast<int>((gap >> 1) ^ (0u - (gap & 1)));
+        while (true) {
+            W offset;
+            std::memcpy(&offset, w, sizeof(W));
+            w += sizeof(W);
+            fn(v, static_cast<int>(minWeight + static_cast<int64_t>(offset)));
+            if (p == end)
+                return;
+            v += static_cast<int>(readVarint(p));
+        }
+    }
+
+    static uint32_t readVarint(const uint8_t*& p) {
+        uint32_t value = *p & 0x7f;
+        for (int shift = 7; *p++ & 0x80; shift += 7)
+            value |= static_cast<uint32_t>(*p & 0x7f) << shift;
+        return value;
+    }
+
+    std::vector<uint64_t> idOffset;    // Byte range of each vertex in ids
+    std::vector<uint64_t> entryOffset; // Neighbour range of each vertex, indexes weights
+    std::vector<uint8_t> ids;
+    std::vector<uint8_t> weights;      // weightWidth bytes per neighbour
+    int weightWidth;
+    int minWeight;
+};
+
+#endif // COMPRESSED_ADJACENCY_H
@@ -0,0 +1,49 @@
+#ifndef CONCURRENT_UNION_FIND_H
+#define CONCURRENT_UNION_FIND_H
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// Lock-free union-find: roots only change through a CAS that links the larger
+// root under the smaller, so the root of a set is always its smallest vertex
+class ConcurrentUnionFind {
+public:
+    explicit ConcurrentUnionFind(int n) : parent(n) {
+        for (int i = 0; i < n; ++i)
+            parent[i].store(i, std::memory_order_relaxed);
+    }
+
+    int find(int x) {
+        while (true) {
+            int p = parent[x].load(std::memory_order_acquire);
+            if (p == x)
+                return x;
+            int gp = parent[p].load(std::memory_order_acquire);
+            if (gp != p) {
+                // Path halving; losing the race only skips a shortcut
+                parent[x].compare_exchange_weak(p, gp, std::memory_order_acq_rel);
+            }
+            x = gp;
+        }
+    }
+
+    void unite(int a, int b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return;
+            if (a < b)
+                std::swap(a, b);
+            int expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+                return;
+        }
+    }
+
+private:
+    std::vector<std::atomic<int>> parent;
+};
+
+#endif // CONCURRENT_UNION_FIND_H
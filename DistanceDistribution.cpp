@@ -0,0 +1,291 @@
+#include "DistanceDistribution.h"
+#include <algorithm>
+#include <future>
+#include <cmath>
+
+DistanceDistribution::DistanceDistribution(int vertices, const std::vector<std::tuple<int, int, int>>& edges, ThreadPool& pool)
+    : vertices(vertices), pool(pool), pair_count(0), distance_sum(0), min_distance(0), max_distance(0) {
+    offsets.assign(vertices + 1, 0);
+    for (const auto& edge : edges) {
+        offsets[std::get<0>(edge) + 1]++;
+        offsets[std::get<1>(edge) + 1]++;
+    }
+    for (int v = 0; v < vertices; ++v)
+        offsets[v + 1] += offsets[v];
+    targets.resize(offsets[vertices]);
+    weights.resize(offsets[vertices]);
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (const auto& edge : edges) {
+        int u = std::get<0>(edge), v = std::get<1>(edge), w = std::get<2>(edge);
+        targets[fill[u]] = v;
+        weights[fill[u]++] = w;
+        targets[fill[v]] = u;
+        weights[fill[v]++] = w;
+    }
+}
+
+void DistanceDistribution::setCancellationToken(std::shared_ptr<const CancellationToken> token) {
+    cancelToken = std::move(token);
+}
+
+void DistanceDistribution::checkCancelled() const {
+    if (cancelToken)
+        cancelToken->throwIfCancelled();
+}
+
+// Finds the centroid of the piece containing start, records its groups, and
+// appends the roots of the pieces left after removing it to next
+void DistanceDistribution::decompose(int start, std::vector<Group>& out, std::vector<int>& next) {
+    // BFS order of the piece, then subtree sizes bottom-up
+    std::vector<int> order{start};
+    parent[start] = -1;
+    for (size_t i = 0; i < order.size(); ++i) {
+        int u = order[i];
+        for (int e = offsets[u]; e < offsets[u + 1]; ++e) {
+            int v = targets[e];
+            if (v != parent[u] && !removed[v]) {
+                parent[v] = u;
+                order.push_back(v);
+            }
+        }
+    }
+    const int size = static_cast<int>(order.size());
+    for (int i = size - 1; i >= 0; --i) {
+        int u = order[i];
+        subtree[u] = 1;
+        for (int e = offsets[u]; e < offsets[u + 1]; ++e) {
+            int v = targets[e];
+            if (v != parent[u] && !removed[v])
+                subtree[u] += subtree[v];
+        }
+    }
+    // Walk towards the heavy child until no part exceeds half the piece
+    int centroid = start;
+    while (true) {
+        int heavy = -1;
+        for (int e = offsets[centroid]; e < offsets[centroid + 1]; ++e) {
+            int v = targets[e];
+            if (v != parent[centroid] && !removed[v] && subtree[v] * 2 > size)
+                heavy = v;
+        }
+        if (heavy < 0)
+            break;
+        centroid = heavy;
+    }
+
+    removed[centroid] = 1;
+    Group all{1, {0}};
+    all.dist.reserve(size);
+    for (int e = offsets[centroid]; e < offsets[centroid + 1]; ++e) {
+        int child = targets[e];
+        if (removed[child])
+            continue;
+        Group part{-1, {}};
+        parent[child] = centroid;
+        depth[child] = weights[e];
+        part.dist.push_back(depth[child]);
+        std::vector<int> queue{child};
+        for (size_t i = 0; i < queue.size(); ++i) {
+            int u = queue[i];
+            for (int f = offsets[u]; f < offsets[u + 1]; ++f) {
+                int v = targets[f];
+                if (v != parent[u] && !removed[v]) {
+                    parent[v] = u;
+                    depth[v] = depth[u] + weights[f];
+                    part.dist.push_back(depth[v]);
+                    queue.push_back(v);
+                }
+            }
+        }
+        std::sort(part.dist.begin(), part.dist.end());
+        all.dist.insert(all.dist.end(), part.dist.begin(), part.dist.end());
+        next.push_back(child);
+        if (part.dist.size() > 1)
+            out.push_back(std::move(part));
+    }
+    std::sort(all.dist.begin(), all.dist.end());
+    if (all.dist.size() > 1)
+        out.push_back(std::move(all));
+}
+
+void DistanceDistribution::build() {
+    removed.assign(vertices, 0);
+    parent.assign(vertices, -1);
+    subtree.assign(vertices, 0);
+    depth.assign(vertices, 0);
+    groups.clear();
+    pair_count = vertices; // Self pairs
+    distance_sum = 0;
+
+    // Level 0 pieces: one per tree, found by the first sweep
+    std::vector<int> level;
+    {
+        std::vector<char> seen(vertices, 0);
+        for (int s = 0; s < vertices; ++s) {
+            if (seen[s])
+                continue;
+            std::vector<int> queue{s};
+            seen[s] = 1;
+            for (size_t i = 0; i < queue.size(); ++i)
+                for (int e = offsets[queue[i]]; e < offsets[queue[i] + 1]; ++e)
+                    if (!seen[targets[e]]) {
+                        seen[targets[e]] = 1;
+                        queue.push_back(targets[e]);
+                    }
+            long long n = static_cast<long long>(queue.size());
+            pair_count += n * (n - 1) / 2;
+            level.push_back(s);
+        }
+    }
+
+    const size_t workers = pool.getMaxThreads();
+    while (!level.empty()) {
+        checkCancelled();
+        size_t tasks_count = std::min(workers, level.size());
+        std::vector<std::future<std::pair<std::vector<Group>, std::vector<int>>>> tasks;
+        for (size_t t = 0; t < tasks_count; ++t) {
+            tasks.push_back(pool.submit([this, &level, t, tasks_count]() {
+                std::pair<std::vector<Group>, std::vector<int>> result;
+                for (size_t i = t; i < level.size(); i += tasks_count) {
+                    if ((i & 255) == 0)
+                        checkCancelled();
+                    decompose(level[i], result.first, result.second);
+                }
+                return result;
+            }));
+        }
+        std::vector<int> next;
+        std::exception_ptr failure;
+        for (auto& task : tasks) {
+            try {
+                auto result = task.get();
+                for (auto& group : result.first)
+                    groups.push_back(std::move(group));
+                next.insert(next.end(), result.second.begin(), result.second.end());
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        }
+        if (failure)
+            std::rethrow_exception(failure);
+        level.swap(next);
+    }
+
+    // Sum over pairs through each centroid: every element pairs with the other size - 1.
+    // Every real pair is in its centroid's group, so the extreme sums there bound the distances.
+    min_distance = 0;
+    max_distance = 0;
+    for (const Group& group : groups) {
+        long double sum = 0;
+        for (long long d : group.dist)
+            sum += d;
+        distance_sum += group.sign * sum * static_cast<long double>(group.dist.size() - 1);
+        if (group.sign > 0) {
+            min_distance = std::min(min_distance, group.dist[0] + group.dist[1]);
+            max_distance = std::max(max_distance, group.dist[group.dist.size() - 1] + group.dist[group.dist.size() - 2]);
+        }
+    }
+
+    // Split the groups into contiguous ranges of similar total length for countAtMost
+    size_t total = 0;
+    for (const Group& group : groups)
+        total += group.dist.size();
+    chunks.assign(1, 0);
+    size_t target = total / workers + 1, acc = 0;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        acc += groups[g].dist.size();
+        if (acc >= target) {
+            chunks.push_back(g + 1);
+            acc = 0;
+        }
+    }
+    if (chunks.back() != groups.size())
+        chunks.push_back(groups.size());
+
+    // Both are only bounds so far; tighten them to the real extremes
+    if (pair_count > 0) {
+        min_distance = percentile(0);
+        max_distance = percentile(100);
+    }
+}
+
+long long DistanceDistribution::getPairCount() const {
+    return pair_count;
+}
+
+double DistanceDistribution::getAverageDistance() const {
+    return pair_count > 0 ? static_cast<double>(distance_sum / pair_count) : 0.0;
+}
+
+long long DistanceDistribution::getMinDistance() const {
+    return min_distance;
+}
+
+long long DistanceDistribution::getMaxDistance() const {
+    return max_distance;
+}
+
+long long DistanceDistribution::countAtMost(long long x) const {
+    std::vector<std::future<long long>> tasks;
+    for (size_t c = 0; c + 1 < chunks.size(); ++c) {
+        size_t begin = chunks[c], end = chunks[c + 1];
+        tasks.push_back(pool.submit([this, begin, end, x]() {
+            long long count = 0;
+            for (size_t g = begin; g < end; ++g) {
+                // Pairs i < j with dist[i] + dist[j] <= x, two pointers from both ends
+                const std::vector<long long>& d = groups[g].dist;
+                long long pairs = 0;
+                size_t i = 0, j = d.size() - 1;
+                while (i < j) {
+                    if (d[i] + d[j] <= x) {
+                        pairs += j - i;
+                        i++;
+                    } else {
+                        j--;
+                    }
+                }
+                count += groups[g].sign * pairs;
+            }
+            return count;
+        }));
+    }
+    long long count = x >= 0 ? vertices : 0; // Self pairs
+    for (auto& task : tasks)
+        count += task.get();
+    return count;
+}
+
+long long DistanceDistribution::percentile(double p) const {
+    checkCancelled();
+    long long rank = static_cast<long long>(std::ceil(std::min(100.0, std::max(0.0, p)) / 100.0 * pair_count));
+    rank = std::max(1LL, std::min(rank, pair_count));
+    long long lo = min_distance, hi = max_distance;
+    while (lo < hi) {
+        checkCancelled();
+        long long mid = lo + (hi - lo) / 2;
+        if (countAtMost(mid) >= rank)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+std::vector<long long> DistanceDistribution::histogram(int buckets) const {
+    std::vector<long long> counts(buckets, 0);
+    long long below = 0;
+    for (int b = 0; b < buckets; ++b) {
+        checkCancelled();
+        long long at_most = countAtMost(bucketEdge(b, buckets));
+        counts[b] = at_most - below;
+        below = at_most;
+    }
+    return counts;
+}
+
+long long DistanceDistribution::bucketEdge(int bucket, int buckets) const {
+    if (bucket + 1 == buckets)
+        return max_distance;
+    double span = static_cast<double>(max_distance) - static_cast<double>(min_distance);
+    return min_distance + static_cast<long long>(span * (bucket + 1) / buckets);
+}
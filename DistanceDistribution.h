@@ -0,0 +1,77 @@
+#ifndef DISTANCE_DISTRIBUTION_H
+#define DISTANCE_DISTRIBUTION_H
+
+#include "ThreadPool.h"
+#include "CancellationToken.h"
+#include <vector>
+#include <tuple>
+#include <memory>
+
+// Exact distribution of MST path lengths over the pairs getAverageDistance()
+// averages (unordered pairs i <= j in one tree, self pairs included).
+//
+// A centroid decomposition stores, for every centroid, the sorted distances of
+// its piece to it, plus the same for each child subtree. The number of pairs
+// within distance X is then a signed sum of two-pointer counts over those
+// arrays (pairs through the centroid, minus pairs inside one child subtree),
+// O(V log V) per threshold; percentiles binary-search the threshold between the
+// shortest and the longest distance. Weights may be negative, so the shortest
+// can be below the 0 of the self pairs. Pieces of one decomposition level and
+// the counts over the arrays run on the pool.
+class DistanceDistribution {
+public:
+    DistanceDistribution(int vertices, const std::vector<std::tuple<int, int, int>>& edges, ThreadPool& pool);
+
+    void setCancellationToken(std::shared_ptr<const CancellationToken> token);
+
+    void build();
+
+    long long getPairCount() const;
+    double getAverageDistance() const;
+    // Shortest pair distance: 0 (the self pairs) unless negative weights make a path shorter
+    long long getMinDistance() const;
+    long long getMaxDistance() const;
+    // Pairs whose distance is at most x
+    long long countAtMost(long long x) const;
+    // Smallest distance d such that at least p percent of pairs are within d (nearest rank)
+    long long percentile(double p) const;
+    // Pair counts over buckets equal-width buckets spanning [getMinDistance(), getMaxDistance()];
+    // the first bucket is closed, the rest cover (bucketEdge(b - 1), bucketEdge(b)]
+    std::vector<long long> histogram(int buckets) const;
+    // Upper end of bucket b of buckets
+    long long bucketEdge(int bucket, int buckets) const;
+
+private:
+    // Sorted distances to a centroid; sign -1 for child subtrees (pairs not through the centroid)
+    struct Group {
+        int sign;
+        std::vector<long long> dist;
+    };
+
+    void decompose(int start, std::vector<Group>& out, std::vector<int>& next);
+    void checkCancelled() const;
+
+    int vertices;
+    ThreadPool& pool;
+    std::shared_ptr<const CancellationToken> cancelToken;
+
+    // Tree in CSR form
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> weights;
+
+    // Per-vertex scratch for the decomposition; pieces of one level touch disjoint entries
+    std::vector<char> removed;
+    std::vector<int> parent;
+    std::vector<int> subtree;
+    std::vector<long long> depth;
+
+    std::vector<Group> groups;
+    std::vector<size_t> chunks; // Group ranges of roughly equal total size, one per task
+    long long pair_count;
+    long double distance_sum; // Overflows long long on large trees with large weights
+    long long min_distance;
+    long long max_distance;
+};
+
+#endif // DISTANCE_DISTRIBUTION_H
@@ -0,0 +1,132 @@
+#include "DistanceSampler.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <future>
+
+namespace {
+const size_t BATCH_SAMPLES = 4096;
+const size_t MIN_SAMPLES = 1024;
+const size_t MAX_SAMPLES = size_t(1) << 24; // Bounds memory kept for percentiles (128 MiB)
+const double Z95 = 1.959963984540054;
+}
+
+DistanceSampler::DistanceSampler(const TreeIndex& index, ThreadPool& pool)
+    : index(index), pool(pool) {}
+
+void DistanceSampler::setCancellationToken(std::shared_ptr<const CancellationToken> token) {
+    cancelToken = std::move(token);
+}
+
+void DistanceSampler::sampleBatch(unsigned long long seed, size_t count, std::chrono::steady_clock::time_point stop,
+                                  std::vector<long long>& out) const {
+    const int V = index.getVertices();
+    std::mt19937_64 rng(seed);
+    // j == V stands for "j = i": every unordered pair, self pairs included, then has probability 2 / (V(V+1))
+    std::uniform_int_distribution<int> pick_i(0, V - 1);
+    std::uniform_int_distribution<int> pick_j(0, V);
+
+    int xs[BATCH_SAMPLES], ys[BATCH_SAMPLES];
+    long long ds[BATCH_SAMPLES];
+    // Pairs in different trees are rejected; give up on a batch that finds almost none
+    size_t attempts = 0;
+    while (out.size() < count && attempts < count * 64) {
+        // A round is as long as all earlier ones together, so it must not outlive the budget
+        if (cancelToken)
+            cancelToken->throwIfCancelled();
+        if (attempts > 0 && std::chrono::steady_clock::now() >= stop)
+            break;
+        size_t n = std::min(BATCH_SAMPLES, count - out.size());
+        for (size_t k = 0; k < n; ++k) {
+            xs[k] = pick_i(rng);
+            int j = pick_j(rng);
+            ys[k] = j == V ? xs[k] : j;
+        }
+        index.distances(xs, ys, ds, n);
+        for (size_t k = 0; k < n; ++k)
+            if (ds[k] != TreeIndex::NO_PATH)
+                out.push_back(ds[k]);
+        attempts += n;
+    }
+}
+
+DistanceEstimate DistanceSampler::estimate(double relativeError, std::chrono::milliseconds budget,
+                                           const std::vector<double>& levels, unsigned seed) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point stop = budget.count() > 0 ? Clock::now() + budget : Clock::time_point::max();
+
+    DistanceEstimate result{0, false, {0, 0, 0}, levels, {}};
+    std::vector<long long> samples;
+    if (index.getVertices() == 0)
+        return result;
+
+    const size_t workers = pool.getMaxThreads();
+    double sum = 0, sum_sq = 0;
+    unsigned long long round = 0;
+    // Each round doubles the sample count, split evenly over the workers
+    size_t target = MIN_SAMPLES;
+    while (true) {
+        if (cancelToken)
+            cancelToken->throwIfCancelled();
+
+        size_t want = std::min(target, MAX_SAMPLES) - samples.size();
+        size_t per_task = (want + workers - 1) / workers;
+        std::vector<std::future<std::vector<long long>>> tasks;
+        for (size_t w = 0; w < workers; ++w) {
+            unsigned long long task_seed = (static_cast<unsigned long long>(seed) << 32) ^ (round * workers + w + 1) * 0x9e3779b97f4a7c15ULL;
+            tasks.push_back(pool.submit([this, task_seed, per_task, stop]() {
+                std::vector<long long> part;
+                part.reserve(per_task);
+                sampleBatch(task_seed, per_task, stop, part);
+                return part;
+            }));
+        }
+        size_t before = samples.size();
+        std::exception_ptr failure;
+        for (auto& task : tasks) {
+            try {
+                std::vector<long long> part = task.get();
+                samples.insert(samples.end(), part.begin(), part.end());
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        }
+        if (failure)
+            std::rethrow_exception(failure);
+        for (size_t k = before; k < samples.size(); ++k) {
+            double d = static_cast<double>(samples[k]);
+            sum += d;
+            sum_sq += d * d;
+        }
+        round++;
+
+        size_t n = samples.size();
+        if (n == 0)
+            return result;
+        double mean = sum / n;
+        double variance = n > 1 ? std::max(0.0, (sum_sq - sum * mean) / (n - 1)) : 0.0;
+        double half = Z95 * std::sqrt(variance / n);
+        result.mean = Interval{mean, mean - half, mean + half};
+        result.converged = half <= relativeError * std::fabs(mean);
+
+        if (result.converged || n >= MAX_SAMPLES || n == before || Clock::now() >= stop)
+            break;
+        target = n * 2;
+    }
+
+    // Distribution-free interval for a percentile: the order statistics
+    // n*p -/+ z*sqrt(n*p*(1-p)) of the sorted sample (normal approximation to the binomial)
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    result.samples = n;
+    for (double level : levels) {
+        double p = std::min(1.0, std::max(0.0, level / 100.0));
+        double rank = p * (n - 1);
+        double spread = Z95 * std::sqrt(n * p * (1 - p));
+        auto at = [&samples, n](double r) {
+            return static_cast<double>(samples[static_cast<size_t>(std::min(std::max(r, 0.0), double(n - 1)))]);
+        };
+        result.percentiles.push_back(Interval{at(std::round(rank)), at(std::floor(rank - spread)), at(std::ceil(rank + spread))});
+    }
+    return result;
+}
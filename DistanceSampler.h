@@ -0,0 +1,52 @@
+#ifndef DISTANCE_SAMPLER_H
+#define DISTANCE_SAMPLER_H
+
+#include "TreeIndex.h"
+#include "ThreadPool.h"
+#include "CancellationToken.h"
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstddef>
+
+// Estimate with a 95% confidence interval
+struct Interval {
+    double value;
+    double low;
+    double high;
+};
+
+struct DistanceEstimate {
+    size_t samples;                 // Connected pairs drawn
+    bool converged;                 // Mean reached the requested relative error
+    Interval mean;
+    std::vector<double> levels;     // Requested percentiles, in [0, 100]
+    std::vector<Interval> percentiles;
+};
+
+// Monte Carlo estimates of MST path-length statistics. Pairs are drawn
+// uniformly from the same population getAverageDistance() averages over
+// (unordered pairs i <= j in one tree, self pairs included), and each draw is
+// an O(1) TreeIndex lookup. Batches run in parallel on the pool until the
+// mean's interval is within the relative error, or the time budget runs out;
+// workers check the budget and the cancellation token every batch of draws.
+class DistanceSampler {
+public:
+    DistanceSampler(const TreeIndex& index, ThreadPool& pool);
+
+    void setCancellationToken(std::shared_ptr<const CancellationToken> token);
+
+    DistanceEstimate estimate(double relativeError, std::chrono::milliseconds budget,
+                              const std::vector<double>& levels, unsigned seed = 0);
+
+private:
+    // Fills out with up to count distances of connected pairs, fewer once stop has passed
+    void sampleBatch(unsigned long long seed, size_t count, std::chrono::steady_clock::time_point stop,
+                     std::vector<long long>& out) const;
+
+    const TreeIndex& index;
+    ThreadPool& pool;
+    std::shared_ptr<const CancellationToken> cancelToken;
+};
+
+#endif // DISTANCE_SAMPLER_H
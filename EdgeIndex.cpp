@@ -0,0 +1,95 @@
+#include "EdgeIndex.h"
+#include <algorithm>
+
+namespace {
+const size_t INITIAL_CAPACITY = 16;
+}
+
+EdgeIndex::EdgeIndex() : table(INITIAL_CAPACITY, Entry{EMPTY, NONE}), count(0), directed(false) {}
+
+void EdgeIndex::clear(bool directedPairs) {
+    table.assign(INITIAL_CAPACITY, Entry{EMPTY, NONE});
+    count = 0;
+    directed = directedPairs;
+}
+
+size_t EdgeIndex::size() const {
+    return count;
+}
+
+uint64_t EdgeIndex::makeKey(int u, int v) const {
+    if (directed)
+        return (static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) | static_cast<uint32_t>(v);
+    uint32_t lo = static_cast<uint32_t>(std::min(u, v));
+    uint32_t hi = static_cast<uint32_t>(std::max(u, v));
+    return (static_cast<uint64_t>(lo) << 32) | hi;
+}
+
+size_t EdgeIndex::hash(uint64_t key) {
+    // splitmix64 finalizer
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return static_cast<size_t>(key);
+}
+
+size_t EdgeIndex::probe(uint64_t key) const {
+    size_t mask = table.size() - 1;
+    size_t pos = hash(key) & mask;
+    while (table[pos].key != EMPTY && table[pos].key != key)
+        pos = (pos + 1) & mask;
+    return pos;
+}
+
+void EdgeIndex::grow() {
+    std::vector<Entry> old(table.size() * 2, Entry{EMPTY, NONE});
+    old.swap(table);
+    for (const auto& entry : old) {
+        if (entry.key != EMPTY)
+            table[probe(entry.key)] = entry;
+    }
+}
+
+uint32_t EdgeIndex::find(int u, int v) const {
+    return table[probe(makeKey(u, v))].slot;
+}
+
+void EdgeIndex::set(int u, int v, uint32_t slot) {
+    uint64_t key = makeKey(u, v);
+    size_t pos = probe(key);
+    if (table[pos].key == EMPTY) {
+        // Keep the load factor at or below one half
+        if ((count + 1) * 2 > table.size()) {
+            grow();
+            pos = probe(key);
+        }
+        count++;
+    }
+    table[pos] = Entry{key, slot};
+}
+
+void EdgeIndex::erase(int u, int v) {
+    size_t mask = table.size() - 1;
+    size_t hole = probe(makeKey(u, v));
+    if (table[hole].key == EMPTY)
+        return;
+    count--;
+
+    // Backward-shift: pull later entries of the cluster into the hole when their
+    // home position does not lie cyclically between the hole and themselves
+    size_t pos = hole;
+    while (true) {
+        pos = (pos + 1) & mask;
+        if (table[pos].key == EMPTY)
+            break;
+        size_t home = hash(table[pos].key) & mask;
+        bool stays = hole <= pos ? (hole < home && home <= pos) : (hole < home || home <= pos);
+        if (!stays) {
+            table[hole] = table[pos];
+            hole = pos;
+        }
+    }
+    table[hole] = Entry{EMPTY, NONE};
+}
@@ -0,0 +1,46 @@
+#ifndef EDGE_INDEX_H
+#define EDGE_INDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Open-addressing hash map from a vertex pair to the slot of that edge in
+// Graph's edge list. Linear probing with backward-shift deletion, so there
+// are no tombstones and lookups stay short under heavy edit workloads.
+// Pairs are unordered unless the index is cleared as directed.
+class EdgeIndex {
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    EdgeIndex();
+
+    void clear(bool directedPairs = false);
+    size_t size() const;
+
+    // Slot of edge (u, v) or NONE; (u, v) and (v, u) are the same edge unless directed
+    uint32_t find(int u, int v) const;
+    // Inserts the pair or repoints it to a new slot
+    void set(int u, int v, uint32_t slot);
+    void erase(int u, int v);
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t slot;
+    };
+
+    static const uint64_t EMPTY = UINT64_MAX;
+
+    uint64_t makeKey(int u, int v) const;
+    static size_t hash(uint64_t key);
+    // Position holding key, or the empty position where it would be inserted
+    size_t probe(uint64_t key) const;
+    void grow();
+
+    std::vector<Entry> table;
+    size_t count;
+    bool directed;
+};
+
+#endif // EDGE_INDEX_H
@@ -0,0 +1,278 @@
+#include "EdmondsMST.h"
+#include "Trace.h"
+#include <queue>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Leftist heaps of incoming edges sharing one node pool. A node's key is exact
+// once every ancestor's pending offset has been pushed down to it.
+class IncomingHeaps {
+public:
+    int add(long long key, int edge) {
+        nodes.push_back({key, 0, edge, -1, -1, 1});
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    long long topKey(int h) const { return nodes[h].key; }
+    int topEdge(int h) const { return nodes[h].edge; }
+
+    // Adds delta to every key in heap h
+    void shift(int h, long long delta) {
+        nodes[h].key += delta;
+        nodes[h].pending += delta;
+    }
+
+    int pop(int h) {
+        pushDown(h);
+        return merge(nodes[h].left, nodes[h].right);
+    }
+
+    // Recursion depth is bounded by the right spines, which are O(log n) long
+    int merge(int a, int b) {
+        if (a < 0)
+            return b;
+        if (b < 0)
+            return a;
+        if (nodes[b].key < nodes[a].key)
+            std::swap(a, b);
+        pushDown(a);
+        nodes[a].right = merge(nodes[a].right, b);
+        if (rank(nodes[a].left) < rank(nodes[a].right))
+            std::swap(nodes[a].left, nodes[a].right);
+        nodes[a].rank = rank(nodes[a].right) + 1;
+        return a;
+    }
+
+private:
+    struct Node {
+        long long key;
+        long long pending;
+        int edge;
+        int left;
+        int right;
+        int rank;
+    };
+
+    int rank(int h) const { return h < 0 ? 0 : nodes[h].rank; }
+
+    void pushDown(int h) {
+        long long delta = nodes[h].pending;
+        if (delta == 0)
+            return;
+        for (int child : {nodes[h].left, nodes[h].right}) {
+            if (child >= 0) {
+                nodes[child].key += delta;
+                nodes[child].pending += delta;
+            }
+        }
+        nodes[h].pending = 0;
+    }
+
+    std::vector<Node> nodes;
+};
+
+// Union by size without path compression, so joins can be undone in order
+class RollbackUnionFind {
+public:
+    explicit RollbackUnionFind(int n) : link(n, -1) {}
+
+    int find(int x) const {
+        while (link[x] >= 0)
+            x = link[x];
+        return x;
+    }
+
+    size_t time() const { return history.size(); }
+
+    bool join(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return false;
+        if (link[a] > link[b])
+            std::swap(a, b);
+        history.emplace_back(a, link[a]);
+        history.emplace_back(b, link[b]);
+        link[a] += link[b];
+        link[b] = a;
+        return true;
+    }
+
+    void rollback(size_t t) {
+        while (history.size() > t) {
+            link[history.back().first] = history.back().second;
+            history.pop_back();
+        }
+    }
+
+private:
+    std::vector<int> link; // Parent, or -size for roots
+    std::vector<std::pair<int, int>> history;
+};
+
+}
+
+EdmondsMST::EdmondsMST(const Graph& graph, int root) : graph(graph), root(root), mst_weight(0) {}
+
+void EdmondsMST::solve() {
+    TraceSpan span("edmonds.solve", "solver", "edges", static_cast<long long>(graph.getEdges().size()));
+    int V = graph.getVertices();
+    mst_edges.clear();
+    mst_weight = 0;
+    reconstruction.reset();
+
+    if (root < 0 || root >= V) {
+        index = std::make_shared<TreeIndex>(V, mst_edges);
+        return;
+    }
+
+    // Only vertices reachable from the root can join the arborescence; renumber them densely
+    const auto& adj = graph.getAdjacencyList();
+    auto compressed = graph.getCompressedAdjacency(); // Set instead of adj in compact mode
+    std::vector<int> local(V, -1);
+    std::vector<int> vertex_of;
+    std::queue<int> bfs;
+    local[root] = 0;
+    vertex_of.push_back(root);
+    bfs.push(root);
+    auto reach = [&](int v, int) {
+        if (local[v] < 0) {
+            local[v] = static_cast<int>(vertex_of.size());
+            vertex_of.push_back(v);
+            bfs.push(v);
+        }
+    };
+    while (!bfs.empty()) {
+        int u = bfs.front(); bfs.pop();
+        if (compressed) {
+            compressed->forEachNeighbor(u, reach);
+        } else {
+            for (const auto& neighbor : adj[u])
+                reach(neighbor.first, neighbor.second);
+        }
+    }
+    int m = static_cast<int>(vertex_of.size());
+    checkCancelled();
+
+    // Candidate edges between reachable vertices, both directions for an undirected graph
+    std::vector<int> from, to, weight;
+    auto addCandidate = [&](int u, int v, int w) {
+        if (local[u] < 0 || local[v] <= 0 || u == v)
+            return; // Unreachable source, edge into the root, or self-loop
+        from.push_back(local[u]);
+        to.push_back(local[v]);
+        weight.push_back(w);
+    };
+    for (const auto& edge : graph.getEdges()) {
+        addCandidate(std::get<0>(edge), std::get<1>(edge), std::get<2>(edge));
+        if (!graph.isDirected())
+            addCandidate(std::get<1>(edge), std::get<0>(edge), std::get<2>(edge));
+    }
+
+    IncomingHeaps heaps;
+    std::vector<int> heap(m, -1);
+    for (size_t e = 0; e < from.size(); ++e)
+        heap[to[e]] = heaps.merge(heap[to[e]], heaps.add(weight[e], static_cast<int>(e)));
+
+    struct Contraction {
+        int vertex;
+        size_t time;
+        std::vector<int> edges;
+    };
+    RollbackUnionFind sets(m);
+    std::vector<Contraction> contractions;
+    std::vector<int> seen(m, -1), in_edge(m, -1), path_edge(m), path_vertex(m);
+    seen[0] = 0;
+
+    // Walk from every vertex along cheapest incoming edges until reaching a solved
+    // part; a walk that closes on itself is a cycle and is contracted
+    unsigned steps = 0;
+    for (int start = 0; start < m; ++start) {
+        int u = start;
+        int depth = 0;
+        while (seen[u] < 0) {
+            if ((++steps & CANCEL_CHECK_MASK) == 0)
+                checkCancelled();
+            if (heap[u] < 0)
+                throw std::logic_error("reachable component without incoming edge");
+
+            int e = heaps.topEdge(heap[u]);
+            heaps.shift(heap[u], -heaps.topKey(heap[u]));
+            heap[u] = heaps.pop(heap[u]);
+            path_edge[depth] = e;
+            path_vertex[depth++] = u;
+            seen[u] = start;
+            u = sets.find(from[e]);
+
+            if (seen[u] == start) {
+                int cycle = -1;
+                int end = depth;
+                size_t time = sets.time();
+                int member;
+                do {
+                    member = path_vertex[--depth];
+                    cycle = heaps.merge(cycle, heap[member]);
+                } while (sets.join(u, member));
+                u = sets.find(u);
+                heap[u] = cycle;
+                seen[u] = -1;
+                contractions.push_back({u, time, std::vector<int>(path_edge.begin() + depth, path_edge.begin() + end)});
+            }
+        }
+        for (int i = 0; i < depth; ++i)
+            in_edge[sets.find(to[path_edge[i]])] = path_edge[i];
+    }
+
+    // Expand contractions newest first: the edge entering a contracted cycle keeps
+    // its target, every other vertex of the cycle takes its cycle edge
+    for (auto it = contractions.rbegin(); it != contractions.rend(); ++it) {
+        sets.rollback(it->time);
+        int entering = in_edge[it->vertex];
+        for (int e : it->edges)
+            in_edge[sets.find(to[e])] = e;
+        in_edge[sets.find(to[entering])] = entering;
+    }
+
+    for (int i = 1; i < m; ++i) {
+        int e = in_edge[i];
+        int u = vertex_of[from[e]];
+        int v = vertex_of[i];
+        mst_edges.emplace_back(u, v, weight[e]);
+        mst_weight += weight[e];
+    }
+
+    index = std::make_shared<TreeIndex>(V, mst_edges, std::vector<int>{root}, threadPool);
+}
+
+long long EdmondsMST::getMSTWeight() const {
+    return mst_weight;
+}
+
+const std::vector<std::tuple<int, int, int>>& EdmondsMST::getMSTEdges() const {
+    return mst_edges;
+}
+
+long long EdmondsMST::getDiameter() const {
+    return index->getDiameter();
+}
+
+double EdmondsMST::getAverageDistance() const {
+    return index->getAverageDistance();
+}
+
+std::shared_ptr<const TreeIndex> EdmondsMST::getTreeIndex() const {
+    return index;
+}
+
+long long EdmondsMST::getShortestDistance(int xi, int xj) const {
+    return index->distance(xi, xj);
+}
+
+long long EdmondsMST::getBottleneck(int xi, int xj) const {
+    std::lock_guard<std::mutex> lock(reconstruction_mutex);
+    if (!reconstruction)
+        reconstruction = KruskalTree::fromMSTEdges(graph.getVertices(), mst_edges);
+    return reconstruction->bottleneck(xi, xj);
+}
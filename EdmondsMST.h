@@ -0,0 +1,48 @@
+// EdmondsMST.h
+#ifndef EDMONDS_MST_H
+#define EDMONDS_MST_H
+
+#include "Graph.h"
+#include "IMSTSolver.h"
+#include "KruskalTree.h"
+#include "TreeIndex.h"
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Minimum spanning arborescence (directed MST) rooted at a chosen vertex, using
+// Tarjan's O(E log V) form of Chu-Liu/Edmonds: every vertex keeps a mergeable
+// (leftist) heap of its incoming edges with lazy weight offsets, cycles are
+// contracted through a rollback union-find, and the chosen edges are recovered
+// by undoing the contractions in reverse. Vertices the root cannot reach are
+// left out of the arborescence. On an undirected graph every edge counts in
+// both directions. Metrics treat the arborescence as an undirected tree.
+class EdmondsMST : public IMSTSolver {
+public:
+    EdmondsMST(const Graph& graph, int root);
+
+    void solve() override;
+    long long getMSTWeight() const override;
+    // (parent, child, weight) for every arborescence edge
+    const std::vector<std::tuple<int, int, int>>& getMSTEdges() const override;
+
+    long long getDiameter() const override;
+    double getAverageDistance() const override;
+    long long getShortestDistance(int xi, int xj) const override;
+    long long getBottleneck(int xi, int xj) const override;
+    std::shared_ptr<const TreeIndex> getTreeIndex() const override;
+
+private:
+    const Graph& graph;
+    int root;
+    long long mst_weight;
+    std::vector<std::tuple<int, int, int>> mst_edges;
+    std::shared_ptr<const TreeIndex> index; // Built by solve(), rooted at root
+    mutable std::unique_ptr<KruskalTree> reconstruction;
+    mutable std::mutex reconstruction_mutex;
+};
+
+#endif // EDMONDS_MST_H
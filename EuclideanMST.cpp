@@ -0,0 +1,179 @@
+#include "EuclideanMST.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+const int LEAF_SIZE = 8;
+const double INF = std::numeric_limits<double>::infinity();
+}
+
+bool EuclideanMST::Candidate::operator<(const Candidate& other) const {
+    if (dist2 != other.dist2)
+        return dist2 < other.dist2;
+    int a_lo = std::min(from, to), a_hi = std::max(from, to);
+    int b_lo = std::min(other.from, other.to), b_hi = std::max(other.from, other.to);
+    return a_lo != b_lo ? a_lo < b_lo : a_hi < b_hi;
+}
+
+EuclideanMST::EuclideanMST(std::vector<double> coords, int dimension)
+    : coords(std::move(coords)), dimension(dimension), mst_weight(0) {
+    if (dimension < 2 || dimension > 3)
+        throw std::invalid_argument("dimension must be 2 or 3");
+    points = static_cast<int>(this->coords.size() / dimension);
+}
+
+void EuclideanMST::setCancellationToken(std::shared_ptr<const CancellationToken> token) {
+    cancelToken = std::move(token);
+}
+
+double EuclideanMST::distance2(int a, int b) const {
+    double sum = 0;
+    for (int d = 0; d < dimension; ++d) {
+        double delta = coords[a * dimension + d] - coords[b * dimension + d];
+        sum += delta * delta;
+    }
+    return sum;
+}
+
+double EuclideanMST::boxDistance2(const Node& node, int point) const {
+    double sum = 0;
+    for (int d = 0; d < dimension; ++d) {
+        double x = coords[point * dimension + d];
+        double delta = x < node.lo[d] ? node.lo[d] - x : (x > node.hi[d] ? x - node.hi[d] : 0.0);
+        sum += delta * delta;
+    }
+    return sum;
+}
+
+int EuclideanMST::build(int begin, int end) {
+    int id = static_cast<int>(nodes.size());
+    nodes.push_back(Node{begin, end, -1, -1, {INF, INF, INF}, {-INF, -INF, -INF}, -1});
+    for (int i = begin; i < end; ++i) {
+        for (int d = 0; d < dimension; ++d) {
+            double x = coords[order[i] * dimension + d];
+            nodes[id].lo[d] = std::min(nodes[id].lo[d], x);
+            nodes[id].hi[d] = std::max(nodes[id].hi[d], x);
+        }
+    }
+    if (end - begin <= LEAF_SIZE)
+        return id;
+
+    // Split at the median of the widest dimension
+    int axis = 0;
+    for (int d = 1; d < dimension; ++d)
+        if (nodes[id].hi[d] - nodes[id].lo[d] > nodes[id].hi[axis] - nodes[id].lo[axis])
+            axis = d;
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [this, axis](int a, int b) {
+        return coords[a * dimension + axis] < coords[b * dimension + axis];
+    });
+    int left = build(begin, mid);
+    int right = build(mid, end);
+    nodes[id].left = left;
+    nodes[id].right = right;
+    return id;
+}
+
+int EuclideanMST::refreshComponents(int node) {
+    Node& n = nodes[node];
+    if (n.left < 0) {
+        n.component = component[order[n.begin]];
+        for (int i = n.begin + 1; i < n.end && n.component >= 0; ++i)
+            if (component[order[i]] != n.component)
+                n.component = -1;
+    } else {
+        int left = refreshComponents(n.left);
+        int right = refreshComponents(n.right);
+        nodes[node].component = left == right ? left : -1;
+    }
+    return nodes[node].component;
+}
+
+void EuclideanMST::nearestOutside(int node, int point, int comp, Candidate& best) const {
+    const Node& n = nodes[node];
+    if (n.component == comp || boxDistance2(n, point) > best.dist2)
+        return;
+    if (n.left < 0) {
+        for (int i = n.begin; i < n.end; ++i) {
+            int other = order[i];
+            if (component[other] == comp)
+                continue;
+            Candidate candidate{distance2(point, other), point, other};
+            if (candidate < best)
+                best = candidate;
+        }
+        return;
+    }
+    // Nearer child first, so the far one is usually pruned
+    int first = n.left, second = n.right;
+    if (boxDistance2(nodes[second], point) < boxDistance2(nodes[first], point))
+        std::swap(first, second);
+    nearestOutside(first, point, comp, best);
+    nearestOutside(second, point, comp, best);
+}
+
+void EuclideanMST::solve() {
+    mst_edges.clear();
+    mst_weight = 0;
+    nodes.clear();
+    order.resize(points);
+    component.resize(points);
+    for (int i = 0; i < points; ++i)
+        order[i] = component[i] = i;
+    if (points < 2)
+        return;
+    build(0, points);
+
+    std::vector<int> parent(points);
+    for (int i = 0; i < points; ++i)
+        parent[i] = i;
+    auto find = [&parent](int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+
+    std::vector<Candidate> best(points);
+    while (static_cast<int>(mst_edges.size()) < points - 1) {
+        if (cancelToken)
+            cancelToken->throwIfCancelled();
+        for (int i = 0; i < points; ++i)
+            component[i] = find(i);
+        refreshComponents(0);
+
+        // Cheapest edge leaving every component; the component's best so far bounds each search
+        for (int i = 0; i < points; ++i)
+            best[i] = Candidate{INF, -1, -1};
+        for (int p = 0; p < points; ++p)
+            nearestOutside(0, p, component[p], best[component[p]]);
+
+        for (int c = 0; c < points; ++c) {
+            if (component[c] != c || best[c].to < 0)
+                continue;
+            int root_u = find(best[c].from);
+            int root_v = find(best[c].to);
+            if (root_u == root_v)
+                continue;
+            parent[root_v] = root_u;
+            double w = std::sqrt(best[c].dist2);
+            mst_edges.emplace_back(best[c].from, best[c].to, w);
+            mst_weight += w;
+        }
+    }
+}
+
+int EuclideanMST::getPoints() const {
+    return points;
+}
+
+double EuclideanMST::getMSTWeight() const {
+    return mst_weight;
+}
+
+const std::vector<std::tuple<int, int, double>>& EuclideanMST::getMSTEdges() const {
+    return mst_edges;
+}
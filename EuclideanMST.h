@@ -0,0 +1,67 @@
+#ifndef EUCLIDEAN_MST_H
+#define EUCLIDEAN_MST_H
+
+#include "CancellationToken.h"
+#include <vector>
+#include <tuple>
+#include <memory>
+
+// MST of the complete Euclidean graph over a 2-D or 3-D point set, without ever
+// materializing its O(n^2) edges. Runs Boruvka rounds in which every point asks
+// a k-d tree for its nearest point in another component; subtrees whose points
+// all share the asking component, or whose box is farther than the best edge
+// found so far for that component, are pruned. Ties are broken by point index
+// so the rounds can never close a cycle.
+class EuclideanMST {
+public:
+    // coords holds points * dimension values, point-major
+    EuclideanMST(std::vector<double> coords, int dimension);
+
+    void setCancellationToken(std::shared_ptr<const CancellationToken> token);
+
+    void solve();
+
+    int getPoints() const;
+    double getMSTWeight() const;
+    // (u, v, distance), 0-based point indices
+    const std::vector<std::tuple<int, int, double>>& getMSTEdges() const;
+
+private:
+    struct Node {
+        int begin;          // Range of order[] covered by this node
+        int end;
+        int left;           // Children, -1 for leaves
+        int right;
+        double lo[3];       // Bounding box
+        double hi[3];
+        int component;      // Shared component of all points below, or -1
+    };
+
+    // Candidate edge of a component: squared distance, then the point pair as tie-breaker
+    struct Candidate {
+        double dist2;
+        int from;
+        int to;
+        bool operator<(const Candidate& other) const;
+    };
+
+    int build(int begin, int end);
+    int refreshComponents(int node);
+    void nearestOutside(int node, int point, int component, Candidate& best) const;
+    double boxDistance2(const Node& node, int point) const;
+    double distance2(int a, int b) const;
+
+    std::vector<double> coords;
+    int dimension;
+    int points;
+    std::shared_ptr<const CancellationToken> cancelToken;
+
+    std::vector<int> order; // Point indices permuted into k-d tree order
+    std::vector<Node> nodes;
+    std::vector<int> component;
+
+    double mst_weight;
+    std::vector<std::tuple<int, int, double>> mst_edges;
+};
+
+#endif // EUCLIDEAN_MST_H
@@ -0,0 +1,259 @@
+#include "ExternalKruskal.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <cstdio>
+#include <cinttypes>
+#include <unistd.h>
+
+namespace {
+
+// Runs merged at once; more runs than this are merged in several passes
+const size_t MAX_FAN_IN = 64;
+// Edges buffered per open run while merging
+const size_t READ_BUFFER_EDGES = 4096;
+
+// Removes the run files it owns when the solve finishes or fails
+struct RunFiles {
+    std::vector<std::string> paths;
+    ~RunFiles() {
+        for (const auto& path : paths)
+            unlink(path.c_str());
+    }
+};
+
+struct FileCloser {
+    void operator()(FILE* file) const { fclose(file); }
+};
+using FileHandle = std::unique_ptr<FILE, FileCloser>;
+
+}
+
+ExternalKruskal::ExternalKruskal(const std::string& workDir, size_t runEdges)
+    : workDir(workDir), runEdges(std::max<size_t>(runEdges, 1)), vertices(0), mst_weight(0), mst_edge_count(0), run_count(0) {}
+
+void ExternalKruskal::setCancellationToken(std::shared_ptr<const CancellationToken> token) {
+    cancelToken = std::move(token);
+}
+
+void ExternalKruskal::checkCancelled() const {
+    if (cancelToken)
+        cancelToken->throwIfCancelled();
+}
+
+std::string ExternalKruskal::newRunPath() {
+    std::string path = workDir + "/mst-run-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+        throw std::runtime_error("cannot create run file in " + workDir);
+    close(fd);
+    return path;
+}
+
+std::string ExternalKruskal::writeRun(std::vector<Edge>& edges) {
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.w < b.w;
+    });
+    std::string path = newRunPath();
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out || fwrite(edges.data(), sizeof(Edge), edges.size(), out) != edges.size()) {
+        if (out)
+            fclose(out);
+        unlink(path.c_str());
+        throw std::runtime_error("cannot write run file " + path);
+    }
+    fclose(out);
+    edges.clear();
+    return path;
+}
+
+std::vector<std::string> ExternalKruskal::formRuns(const std::string& inputPath) {
+    std::ifstream in(inputPath);
+    if (!in)
+        throw std::runtime_error("cannot open " + inputPath);
+
+    long long declared_edges;
+    if (!(in >> vertices >> declared_edges) || vertices <= 0)
+        throw std::runtime_error("missing 'vertices edges' header in " + inputPath);
+
+    std::vector<std::string> runs;
+    std::vector<Edge> buffer;
+    buffer.reserve(std::min<size_t>(runEdges, declared_edges > 0 ? declared_edges : 1));
+    try {
+        int u, v, w;
+        while (in >> u >> v >> w) {
+            if (u < 1 || u > vertices || v < 1 || v > vertices)
+                throw std::runtime_error("edge endpoint out of range in " + inputPath);
+            buffer.push_back({u - 1, v - 1, w});
+            if (buffer.size() == runEdges) {
+                checkCancelled();
+                runs.push_back(writeRun(buffer));
+            }
+        }
+        if (!in.eof())
+            throw std::runtime_error("malformed edge line in " + inputPath);
+        if (!buffer.empty())
+            runs.push_back(writeRun(buffer));
+    } catch (...) {
+        for (const auto& path : runs)
+            unlink(path.c_str());
+        throw;
+    }
+    return runs;
+}
+
+template <typename Sink>
+void ExternalKruskal::mergeRuns(const std::vector<std::string>& runs, Sink sink) {
+    struct Reader {
+        FILE* file = nullptr;
+        std::vector<Edge> buffer;
+        size_t pos = 0;
+
+        bool next(Edge& edge) {
+            if (pos == buffer.size()) {
+                buffer.resize(READ_BUFFER_EDGES);
+                buffer.resize(fread(buffer.data(), sizeof(Edge), READ_BUFFER_EDGES, file));
+                pos = 0;
+                if (buffer.empty())
+                    return false;
+            }
+            edge = buffer[pos++];
+            return true;
+        }
+    };
+
+    std::vector<Reader> readers(runs.size());
+    auto closeAll = [&readers]() {
+        for (auto& reader : readers)
+            if (reader.file)
+                fclose(reader.file);
+    };
+    for (size_t i = 0; i < runs.size(); ++i) {
+        readers[i].file = fopen(runs[i].c_str(), "rb");
+        if (!readers[i].file) {
+            closeAll();
+            throw std::runtime_error("cannot read run file " + runs[i]);
+        }
+    }
+
+    // Ties are broken by run index, which keeps the merge stable
+    using Head = std::tuple<int32_t, size_t, Edge>;
+    auto later = [](const Head& a, const Head& b) {
+        return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) > std::get<0>(b) : std::get<1>(a) > std::get<1>(b);
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    Edge edge;
+    for (size_t i = 0; i < readers.size(); ++i)
+        if (readers[i].next(edge))
+            heads.emplace(edge.w, i, edge);
+
+    try {
+        size_t steps = 0;
+        while (!heads.empty()) {
+            if ((++steps & 0xFFFF) == 0)
+                checkCancelled();
+            auto [w, run, head] = heads.top();
+            heads.pop();
+            if (!sink(head))
+                break;
+            if (readers[run].next(edge))
+                heads.emplace(edge.w, run, edge);
+        }
+    } catch (...) {
+        closeAll();
+        throw;
+    }
+    closeAll();
+}
+
+void ExternalKruskal::solve(const std::string& inputPath, const std::string& outputPath) {
+    mst_weight = 0;
+    mst_edge_count = 0;
+
+    RunFiles files;
+    files.paths = formRuns(inputPath);
+    run_count = files.paths.size();
+
+    // Merge passes until a single pass can take every run
+    while (files.paths.size() > MAX_FAN_IN) {
+        // Owns each merged run from the moment it is created, so a failed or cancelled pass removes it
+        RunFiles merged;
+        for (size_t begin = 0; begin < files.paths.size(); begin += MAX_FAN_IN) {
+            size_t end = std::min(files.paths.size(), begin + MAX_FAN_IN);
+            std::vector<std::string> group(files.paths.begin() + begin, files.paths.begin() + end);
+            std::string path = newRunPath();
+            merged.paths.push_back(path);
+            FileHandle out(fopen(path.c_str(), "wb"));
+            if (!out)
+                throw std::runtime_error("cannot write run file " + path);
+            bool ok = true;
+            mergeRuns(group, [&out, &ok](const Edge& edge) {
+                ok = fwrite(&edge, sizeof(Edge), 1, out.get()) == 1;
+                return ok;
+            });
+            if (!ok || fclose(out.release()) != 0)
+                throw std::runtime_error("cannot write run file " + path);
+        }
+        // The inputs of this pass are removed as merged goes out of scope
+        files.paths.swap(merged.paths);
+    }
+
+    FileHandle out(fopen(outputPath.c_str(), "w"));
+    if (!out)
+        throw std::runtime_error("cannot open " + outputPath);
+    // The edge count is only known at the end; reserve a fixed-width field for it
+    fprintf(out.get(), "%d %20s\n", vertices, "");
+
+    std::vector<int32_t> parent(vertices);
+    std::vector<uint8_t> rank(vertices, 0);
+    for (int i = 0; i < vertices; ++i)
+        parent[i] = i;
+    auto find = [&parent](int32_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+
+    size_t needed = vertices - 1;
+    mergeRuns(files.paths, [&](const Edge& edge) {
+        int32_t root_u = find(edge.u);
+        int32_t root_v = find(edge.v);
+        if (root_u != root_v) {
+            if (rank[root_u] < rank[root_v])
+                std::swap(root_u, root_v);
+            parent[root_v] = root_u;
+            if (rank[root_u] == rank[root_v])
+                rank[root_u]++;
+            fprintf(out.get(), "%d %d %d\n", edge.u + 1, edge.v + 1, edge.w);
+            mst_weight += edge.w;
+            mst_edge_count++;
+        }
+        // A spanning tree is complete; the rest of the stream cannot add edges
+        return mst_edge_count < needed;
+    });
+
+    fseek(out.get(), 0, SEEK_SET);
+    fprintf(out.get(), "%d %20zu\n", vertices, mst_edge_count);
+    if (fclose(out.release()) != 0)
+        throw std::runtime_error("cannot write " + outputPath);
+}
+
+int ExternalKruskal::getVertices() const {
+    return vertices;
+}
+
+long long ExternalKruskal::getMSTWeight() const {
+    return mst_weight;
+}
+
+size_t ExternalKruskal::getMSTEdgeCount() const {
+    return mst_edge_count;
+}
+
+size_t ExternalKruskal::getRunCount() const {
+    return run_count;
+}
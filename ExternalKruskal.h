@@ -0,0 +1,55 @@
+#ifndef EXTERNAL_KRUSKAL_H
+#define EXTERNAL_KRUSKAL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "CancellationToken.h"
+
+// Out-of-core Kruskal for edge files that do not fit in memory. The input uses
+// the upload format ("vertices edges" header, then 1-based "u v weight" lines).
+// Edges are sorted into bounded on-disk runs, the runs are merged in weight
+// order through a union-find that needs O(V) memory, and the MST edges are
+// written to the output file in the same format, ready to be loaded as a graph.
+class ExternalKruskal {
+public:
+    // runEdges bounds how many edges are held in memory while forming a run
+    ExternalKruskal(const std::string& workDir, size_t runEdges);
+
+    void setCancellationToken(std::shared_ptr<const CancellationToken> token);
+
+    // Throws std::runtime_error on I/O or format errors
+    void solve(const std::string& inputPath, const std::string& outputPath);
+
+    int getVertices() const;
+    long long getMSTWeight() const;
+    size_t getMSTEdgeCount() const;
+    size_t getRunCount() const;
+
+private:
+    struct Edge {
+        int32_t u;
+        int32_t v;
+        int32_t w;
+    };
+
+    std::vector<std::string> formRuns(const std::string& inputPath);
+    // Merges runs into one weight-ordered stream and hands each edge to sink
+    template <typename Sink>
+    void mergeRuns(const std::vector<std::string>& runs, Sink sink);
+    std::string writeRun(std::vector<Edge>& edges);
+    std::string newRunPath();
+    void checkCancelled() const;
+
+    std::string workDir;
+    size_t runEdges;
+    std::shared_ptr<const CancellationToken> cancelToken;
+
+    int vertices;
+    long long mst_weight;
+    size_t mst_edge_count;
+    size_t run_count;
+};
+
+#endif // EXTERNAL_KRUSKAL_H
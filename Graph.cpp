@@ -22,39 +22,253 @@ void Graph::destroyInstance() {
     }
 }
 
-void Graph::newGraph(int v, int e) {
-    std::lock_guard<std::mutex> lock(mtx);
+void Graph::resetLocked(int v, int e, bool isDirected) {
     vertices.store(v);
+    directed.store(isDirected);
     edgeList.clear();
+    edgeList.reserve(e);
+    edgeCount.store(0);
+    adjRefs.clear();
+    edgeIndex.clear(isDirected);
     adj.clear();
-    adj.resize(v);
+    compressed.reset();
+    if (!compact) {
+        adjRefs.reserve(e);
+        adj.resize(v);
+    }
+}
+
+// u and v are 0-based; change (if any) receives what was overwritten
+void Graph::setEdgeLocked(int u, int v, int w, GraphChange* change) {
+    uint32_t slot = edgeIndex.find(u, v);
+    if (slot != EdgeIndex::NONE) {
+        // Duplicate: update the weight in place
+        if (change) {
+            change->existed = true;
+            change->previous = std::get<2>(edgeList[slot]);
+        }
+        std::get<2>(edgeList[slot]) = w;
+        if (!compact) {
+            adjRefs[slot].first->second = w;
+            if (!directed)
+                adjRefs[slot].second->second = w;
+        }
+    } else {
+        edgeIndex.set(u, v, static_cast<uint32_t>(edgeList.size()));
+        edgeList.emplace_back(u, v, w);
+        edgeCount.store(edgeList.size());
+        if (!compact) {
+            adj[u].emplace_back(v, w);
+            auto u_node = std::prev(adj[u].end());
+            if (directed) {
+                adjRefs.emplace_back(u_node, u_node);
+            } else {
+                adj[v].emplace_back(u, w);
+                adjRefs.emplace_back(u_node, std::prev(adj[v].end()));
+            }
+        }
+    }
+    compressed.reset();
+}
+
+bool Graph::eraseEdgeLocked(int u, int v, int* removed) {
+    uint32_t slot = edgeIndex.find(u, v);
+    if (slot == EdgeIndex::NONE)
+        return false;
+    if (removed)
+        *removed = std::get<2>(edgeList[slot]);
+
+    if (!compact) {
+        adj[std::get<0>(edgeList[slot])].erase(adjRefs[slot].first);
+        if (!directed)
+            adj[std::get<1>(edgeList[slot])].erase(adjRefs[slot].second);
+    }
+    edgeIndex.erase(u, v);
+    compressed.reset();
+
+    uint32_t last = static_cast<uint32_t>(edgeList.size() - 1);
+    if (slot != last) {
+        edgeList[slot] = edgeList[last];
+        if (!compact)
+            adjRefs[slot] = adjRefs[last];
+        edgeIndex.set(std::get<0>(edgeList[slot]), std::get<1>(edgeList[slot]), slot);
+    }
+    edgeList.pop_back();
+    edgeCount.store(edgeList.size());
+    if (!compact)
+        adjRefs.pop_back();
+    return true;
+}
+
+void Graph::applyLocked(const GraphChange& change, bool undo) {
+    switch (change.kind) {
+    case GraphChange::Kind::SET_EDGE:
+        if (!undo)
+            setEdgeLocked(change.u, change.v, change.weight, nullptr);
+        else if (change.existed)
+            setEdgeLocked(change.u, change.v, change.previous, nullptr);
+        else
+            eraseEdgeLocked(change.u, change.v, nullptr);
+        break;
+    case GraphChange::Kind::ERASE_EDGE:
+        if (undo)
+            setEdgeLocked(change.u, change.v, change.previous, nullptr);
+        else
+            eraseEdgeLocked(change.u, change.v, nullptr);
+        break;
+    case GraphChange::Kind::RESET:
+        if (undo) {
+            const GraphSnapshot& before = *change.before;
+            resetLocked(before.vertices, static_cast<int>(before.edges.size()), before.directed);
+            for (const auto& edge : before.edges)
+                setEdgeLocked(std::get<0>(edge), std::get<1>(edge), std::get<2>(edge), nullptr);
+        } else {
+            resetLocked(change.vertices, 0, change.directed);
+        }
+        break;
+    }
+}
+
+bool Graph::moveLocked(const GraphHistory& source, uint64_t v) {
+    std::vector<GraphHistory::Step> undo, redo;
+    if (!source.path(version.load(), v, undo, redo))
+        return false;
+    for (const auto& step : undo)
+        for (auto it = step.changes->rbegin(); it != step.changes->rend(); ++it)
+            applyLocked(*it, true);
+    for (const auto& step : redo)
+        for (const auto& change : *step.changes)
+            applyLocked(change, false);
+    version.store(v);
+    return true;
+}
+
+void Graph::recordLocked(GraphChange change) {
+    if (history.getCapacity() > 0)
+        pending.push_back(std::move(change));
+    if (batchDepth == 0)
+        commitLocked();
+    else
+        batchChanged = true;
+}
+
+void Graph::commitLocked() {
+    uint64_t parent = version.load();
+    version.store(++lastVersion);
+    history.record(parent, lastVersion, std::move(pending), lastVersion);
+    pending.clear();
+}
+
+void Graph::beginBatch() {
+    std::lock_guard<std::mutex> lock(mtx);
+    batchDepth++;
+}
+
+void Graph::commitBatch() {
+    std::lock_guard<std::mutex> lock(mtx);
+    // A batch without mutations leaves the version alone
+    if (--batchDepth == 0 && batchChanged) {
+        batchChanged = false;
+        commitLocked();
+    }
+}
+
+void Graph::newGraph(int v, int e, bool isDirected) {
+    std::lock_guard<std::mutex> lock(mtx);
+    GraphChange change{GraphChange::Kind::RESET};
+    change.vertices = v;
+    change.directed = isDirected;
+    // The old edges move into the snapshot rather than being copied; a graph larger than the
+    // whole history budget is not kept at all, and the history starts over at this version
+    size_t bytes = edgeList.capacity() * sizeof(edgeList[0]);
+    size_t budget = history.getByteCapacity();
+    if (history.getCapacity() > 0 && (budget == 0 || bytes <= budget))
+        change.before = std::make_shared<GraphSnapshot>(GraphSnapshot{vertices.load(), directed.load(), std::move(edgeList)});
+    // History replay keeps whatever mode is current; both modes hold the same graph
+    compact = compactThreshold > 0 && e >= 0 && static_cast<size_t>(e) >= compactThreshold;
+    resetLocked(v, e, isDirected);
+    recordLocked(std::move(change));
 }
 
 void Graph::newEdge(int u, int v, int w) {
     std::lock_guard<std::mutex> lock(mtx);
-    edgeList.emplace_back(u - 1, v - 1, w);
-    adj[u - 1].emplace_back(v - 1, w);
-    adj[v - 1].emplace_back(u - 1, w);
+    GraphChange change{GraphChange::Kind::SET_EDGE};
+    change.u = u - 1;
+    change.v = v - 1;
+    change.weight = w;
+    setEdgeLocked(u - 1, v - 1, w, &change);
+    recordLocked(std::move(change));
 }
 
 void Graph::removeEdge(int u, int v) {
     std::lock_guard<std::mutex> lock(mtx);
-    auto it = std::remove_if(edgeList.begin(), edgeList.end(),
-        [u, v](const std::tuple<int, int, int>& edge) {
-            return (std::get<0>(edge) == u - 1 && std::get<1>(edge) == v - 1) ||
-                   (std::get<0>(edge) == v - 1 && std::get<1>(edge) == u - 1);
-        });
-    if (it != edgeList.end()) {
-        edgeList.erase(it, edgeList.end());
-        adj[u - 1].remove_if([v](const std::pair<int, int>& neighbor) { return neighbor.first == v - 1; });
-        adj[v - 1].remove_if([u](const std::pair<int, int>& neighbor) { return neighbor.first == u - 1; });
-    }
+    GraphChange change{GraphChange::Kind::ERASE_EDGE};
+    change.u = u - 1;
+    change.v = v - 1;
+    if (!eraseEdgeLocked(u - 1, v - 1, &change.previous))
+        return;
+    recordLocked(std::move(change));
+}
+
+void Graph::setCompactThreshold(size_t edges) {
+    std::lock_guard<std::mutex> lock(mtx);
+    compactThreshold = edges;
+}
+
+void Graph::setHistoryCapacity(size_t capacity, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mtx);
+    history.reset(capacity, bytes, version.load());
+}
+
+bool Graph::hasVersion(uint64_t v) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return v == version.load() || history.contains(v);
+}
+
+std::vector<GraphHistory::VersionInfo> Graph::getHistory() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return history.versions();
+}
+
+bool Graph::checkout(uint64_t v) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (batchDepth > 0)
+        return false;
+    return v == version.load() || moveLocked(history, v);
+}
+
+std::unique_ptr<Graph> Graph::snapshotAt(uint64_t v) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (v != version.load() && !history.contains(v))
+        return nullptr;
+    std::unique_ptr<Graph> copy(new Graph());
+    copy->compact = compact;
+    copy->resetLocked(vertices.load(), static_cast<int>(edgeList.size()), directed.load());
+    for (const auto& edge : edgeList)
+        copy->setEdgeLocked(std::get<0>(edge), std::get<1>(edge), std::get<2>(edge), nullptr);
+    copy->version.store(version.load());
+    copy->lastVersion = lastVersion;
+    if (!copy->moveLocked(history, v))
+        return nullptr;
+    return copy;
 }
 
 int Graph::getVertices() const {
     return vertices.load();
 }
 
+size_t Graph::getEdgeCount() const {
+    return edgeCount.load();
+}
+
+uint64_t Graph::getVersion() const {
+    return version.load();
+}
+
+bool Graph::isDirected() const {
+    return directed.load();
+}
+
 const std::vector<std::tuple<int, int, int>>& Graph::getEdges() const {
     std::lock_guard<std::mutex> lock(mtx);
     return edgeList;
@@ -65,6 +279,15 @@ const std::vector<std::list<std::pair<int, int>>>& Graph::getAdjacencyList() con
     return adj;
 }
 
+std::shared_ptr<const CompressedAdjacency> Graph::getCompressedAdjacency() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!compact)
+        return nullptr;
+    if (!compressed)
+        compressed = std::make_shared<CompressedAdjacency>(vertices.load(), edgeList, directed.load());
+    return compressed;
+}
+
 void Graph::calculateMST(MSTType type) {
     auto mstSolver = MSTFactory::createMST(type, *this);
     if (mstSolver) {
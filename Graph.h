@@ -8,24 +8,56 @@
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <cstdint>
+#include "EdgeIndex.h"
+#include "GraphHistory.h"
+#include "CompressedAdjacency.h"
 
 enum class MSTType;
 
 class Graph {
 private:
     std::atomic<int> vertices; // Number of vertices in the graph
+    std::atomic<size_t> edgeCount; // edgeList.size(), readable without the lock
+    std::atomic<uint64_t> version; // Id of the current contents, keys cached results
+    std::atomic<bool> directed; // Directed graphs store each edge once, in adj[u] only
+    uint64_t lastVersion; // Largest id handed out; every committed mutation gets a fresh one
     std::vector<std::tuple<int, int, int>> edgeList; // List of edges (u, v, weight)
     std::vector<std::list<std::pair<int, int>>> adj; // Adjacency list (vertex, weight)
+    // adj nodes of each edgeList slot (in adj[u] and adj[v]), for O(1) unlinking;
+    // the second one is unused for directed graphs
+    std::vector<std::pair<std::list<std::pair<int, int>>::iterator, std::list<std::pair<int, int>>::iterator>> adjRefs;
+    // Compact mode keeps no adj lists; adjacency is encoded on demand into compressed
+    bool compact;
+    size_t compactThreshold; // newGraph switches to compact mode from this many edges (0 = never)
+    mutable std::shared_ptr<const CompressedAdjacency> compressed; // Dropped on every mutation
+    EdgeIndex edgeIndex; // (u, v) -> edgeList slot
+    GraphHistory history; // Retained versions, empty unless enabled
+    std::vector<GraphChange> pending; // Changes of the open batch (only recorded with history)
+    int batchDepth; // Mutations commit as one version once this drops back to 0
+    bool batchChanged; // The open batch mutated the graph
     mutable std::mutex mtx; // Mutex for thread safety
 
+    // Unlocked primitives shared by the public mutations and by history replay
+    void resetLocked(int v, int e, bool isDirected);
+    void setEdgeLocked(int u, int v, int w, GraphChange* change);
+    bool eraseEdgeLocked(int u, int v, int* removed);
+    void applyLocked(const GraphChange& change, bool undo);
+    // Applies the steps from the current version to v
+    bool moveLocked(const GraphHistory& source, uint64_t v);
+    void recordLocked(GraphChange change);
+    void commitLocked();
+
     // Singleton instance
     static std::atomic<Graph*> instance;
     static std::mutex instance_mtx; // Mutex to protect instance creation/destruction
 
-    // Private constructor
-    Graph() : vertices(0) {}
-
 public:
+    // Standalone graphs (e.g. per-component subgraphs) are constructed directly;
+    // the server's shared graph is the singleton below
+    Graph() : vertices(0), edgeCount(0), version(0), directed(false), lastVersion(0), compact(false), compactThreshold(0), batchDepth(0),
+              batchChanged(false) {}
+
     // Get singleton instance
     static Graph* getInstance();
 
@@ -33,19 +65,55 @@ public:
     Graph(const Graph&) = delete;
     void operator=(const Graph&) = delete;
 
-    // Create a new graph
-    void newGraph(int v, int e);
+    // Create a new graph; announcing at least the compact threshold of edges selects compact mode
+    void newGraph(int v, int e, bool isDirected = false);
 
-    // Add a new edge
+    // Graphs created with at least this many edges store their adjacency compressed
+    // (0 = never); takes effect at the next newGraph
+    void setCompactThreshold(size_t edges);
+
+    // Add a new edge, or update the weight if (u, v) already exists
     void newEdge(int u, int v, int w);
 
-    // Remove an edge
+    // Remove an edge in O(1): the last edge is moved into its slot
     void removeEdge(int u, int v);
 
+    // Groups the mutations made while it is alive into one version
+    class Batch {
+    public:
+        explicit Batch(Graph& graph) : graph(graph) { graph.beginBatch(); }
+        ~Batch() { graph.commitBatch(); }
+        Batch(const Batch&) = delete;
+        void operator=(const Batch&) = delete;
+
+    private:
+        Graph& graph;
+    };
+    void beginBatch();
+    void commitBatch();
+
+    // Keeps up to capacity versions (0 = none) pinning at most bytes, starting from the current one
+    void setHistoryCapacity(size_t capacity, size_t bytes);
+    bool hasVersion(uint64_t v) const;
+    std::vector<GraphHistory::VersionInfo> getHistory() const;
+    // Moves the graph to a retained version; later mutations branch from it
+    bool checkout(uint64_t v);
+    // Standalone copy of a retained version, or nullptr
+    std::unique_ptr<Graph> snapshotAt(uint64_t v) const;
+
     // Getters
     int getVertices() const;
+    // Lock-free, unlike getEdges().size(); for estimates made while other threads mutate
+    size_t getEdgeCount() const;
+    uint64_t getVersion() const;
+    bool isDirected() const;
     const std::vector<std::tuple<int, int, int>>& getEdges() const;
+    // Out-neighbours; for undirected graphs every edge appears at both ends.
+    // Empty in compact mode, where getCompressedAdjacency() serves instead.
     const std::vector<std::list<std::pair<int, int>>>& getAdjacencyList() const;
+    // The same adjacency, compressed; nullptr unless in compact mode. Encoded on
+    // first use after a mutation, then shared until the next one.
+    std::shared_ptr<const CompressedAdjacency> getCompressedAdjacency() const;
 
     // Function to calculate the MST using the factory pattern
     void calculateMST(MSTType type);
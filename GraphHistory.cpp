@@ -0,0 +1,132 @@
+#include "GraphHistory.h"
+#include <algorithm>
+
+GraphHistory::GraphHistory(size_t capacity, size_t byteCapacity) : capacity(capacity), byteCapacity(byteCapacity), bytes(0) {}
+
+size_t GraphHistory::getCapacity() const {
+    return capacity;
+}
+
+size_t GraphHistory::getByteCapacity() const {
+    return byteCapacity;
+}
+
+void GraphHistory::reset(size_t newCapacity, size_t newByteCapacity, uint64_t root) {
+    capacity = newCapacity;
+    byteCapacity = newByteCapacity;
+    nodes.clear();
+    bytes = 0;
+    if (capacity > 0)
+        startOver(root);
+}
+
+void GraphHistory::startOver(uint64_t root) {
+    nodes.clear();
+    nodes[root] = Node{NONE, 0, 0, {}, sizeof(Node)};
+    bytes = sizeof(Node);
+}
+
+size_t GraphHistory::bytesOf(const std::vector<GraphChange>& changes) {
+    size_t total = sizeof(Node) + changes.capacity() * sizeof(GraphChange);
+    for (const auto& change : changes)
+        if (change.before)
+            total += sizeof(GraphSnapshot) + change.before->edges.capacity() * sizeof(change.before->edges[0]);
+    return total;
+}
+
+void GraphHistory::record(uint64_t parent, uint64_t version, std::vector<GraphChange> changes, uint64_t keep) {
+    if (capacity == 0)
+        return;
+    bool boundary = std::any_of(changes.begin(), changes.end(), [](const GraphChange& change) {
+        return change.kind == GraphChange::Kind::RESET && !change.before;
+    });
+    auto it = nodes.find(parent);
+    if (it == nodes.end() || boundary) {
+        // The parent fell out of the history, or cannot be restored: start over from this version
+        startOver(version);
+        return;
+    }
+    it->second.children++;
+    size_t size = bytesOf(changes);
+    nodes[version] = Node{parent, it->second.depth + 1, 0, std::move(changes), size};
+    bytes += size;
+    evict(keep);
+}
+
+// Drops the oldest root while it has a single child (that child becomes the base,
+// its changes no longer needed), otherwise the oldest leaf other than keep
+void GraphHistory::evict(uint64_t keep) {
+    while (nodes.size() > capacity || (byteCapacity > 0 && bytes > byteCapacity)) {
+        auto root = nodes.end();
+        for (auto it = nodes.begin(); it != nodes.end(); ++it)
+            if (it->second.parent == NONE) {
+                root = it;
+                break;
+            }
+        if (root != nodes.end() && root->first != keep && root->second.children == 1) {
+            uint64_t id = root->first;
+            bytes -= root->second.bytes;
+            nodes.erase(root);
+            for (auto& entry : nodes)
+                if (entry.second.parent == id) {
+                    entry.second.parent = NONE;
+                    entry.second.changes.clear();
+                    entry.second.changes.shrink_to_fit();
+                    bytes -= entry.second.bytes - sizeof(Node);
+                    entry.second.bytes = sizeof(Node);
+                    break;
+                }
+            continue;
+        }
+
+        auto leaf = nodes.end();
+        for (auto it = nodes.begin(); it != nodes.end(); ++it)
+            if (it->second.children == 0 && it->first != keep && it->second.parent != NONE) {
+                leaf = it;
+                break;
+            }
+        if (leaf == nodes.end())
+            return;
+        nodes[leaf->second.parent].children--;
+        bytes -= leaf->second.bytes;
+        nodes.erase(leaf);
+    }
+}
+
+bool GraphHistory::contains(uint64_t version) const {
+    return nodes.count(version) > 0;
+}
+
+bool GraphHistory::path(uint64_t from, uint64_t to, std::vector<Step>& undo, std::vector<Step>& redo) const {
+    undo.clear();
+    redo.clear();
+    auto a = nodes.find(from);
+    auto b = nodes.find(to);
+    if (a == nodes.end() || b == nodes.end())
+        return false;
+
+    // Climb the deeper side first, then both, until they meet
+    while (a != b) {
+        if (a->second.depth >= b->second.depth) {
+            if (a->second.parent == NONE)
+                return false;
+            undo.push_back(Step{a->first, &a->second.changes});
+            a = nodes.find(a->second.parent);
+        } else {
+            if (b->second.parent == NONE)
+                return false;
+            redo.push_back(Step{b->first, &b->second.changes});
+            b = nodes.find(b->second.parent);
+        }
+    }
+    std::reverse(redo.begin(), redo.end());
+    return true;
+}
+
+std::vector<GraphHistory::VersionInfo> GraphHistory::versions() const {
+    std::vector<VersionInfo> result;
+    result.reserve(nodes.size());
+    for (const auto& entry : nodes)
+        result.push_back(VersionInfo{entry.first, entry.second.parent, entry.second.changes.size()});
+    return result;
+}
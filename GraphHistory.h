@@ -0,0 +1,88 @@
+#ifndef GRAPH_HISTORY_H
+#define GRAPH_HISTORY_H
+
+#include <vector>
+#include <tuple>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Whole graph contents, kept only by the changes that wipe them (newGraph)
+struct GraphSnapshot {
+    int vertices;
+    bool directed;
+    std::vector<std::tuple<int, int, int>> edges;
+};
+
+// One recorded mutation, together with what it overwrote so it can be undone
+struct GraphChange {
+    enum class Kind { SET_EDGE, ERASE_EDGE, RESET };
+    Kind kind;
+    int u = 0, v = 0;       // 0-based endpoints (edge changes)
+    int weight = 0;         // New weight (SET_EDGE)
+    bool existed = false;   // Edge already existed (SET_EDGE)
+    int previous = 0;       // Weight before (SET_EDGE when existed, ERASE_EDGE)
+    int vertices = 0;       // New vertex count (RESET)
+    bool directed = false;  // New directedness (RESET)
+    // Graph before (RESET); null when it was too large to keep, and the history starts over there
+    std::shared_ptr<const GraphSnapshot> before;
+};
+
+// Tree of retained graph versions. Each version stores only the changes that
+// lead to it from its parent, so a mutation batch costs O(change) and moving
+// between two versions replays the changes along the path through their
+// common ancestor. Versions branch when edits follow a rollback. Retention is
+// bounded both in versions and in the bytes their changes and snapshots pin.
+class GraphHistory {
+public:
+    static constexpr uint64_t NONE = UINT64_MAX;
+
+    struct Step {
+        uint64_t version;
+        const std::vector<GraphChange>* changes;
+    };
+
+    struct VersionInfo {
+        uint64_t version;
+        uint64_t parent; // NONE for the oldest retained version
+        size_t changes;
+    };
+
+    // capacity 0 disables recording; byteCapacity 0 leaves the bytes unbounded
+    explicit GraphHistory(size_t capacity = 0, size_t byteCapacity = 0);
+
+    size_t getCapacity() const;
+    size_t getByteCapacity() const;
+    // Starts a new history whose only version is root
+    void reset(size_t capacity, size_t byteCapacity, uint64_t root);
+
+    // Adds version as a child of parent, then evicts down to both capacities, never evicting keep.
+    // A reset without a snapshot among changes makes version the new oldest one.
+    void record(uint64_t parent, uint64_t version, std::vector<GraphChange> changes, uint64_t keep);
+
+    bool contains(uint64_t version) const;
+    // Versions to undo (newest first) and to redo (oldest first) to get from one version to another
+    bool path(uint64_t from, uint64_t to, std::vector<Step>& undo, std::vector<Step>& redo) const;
+    std::vector<VersionInfo> versions() const;
+
+private:
+    struct Node {
+        uint64_t parent;
+        int depth;
+        size_t children;
+        std::vector<GraphChange> changes; // parent -> this version
+        size_t bytes;                     // Pinned by changes, snapshots included
+    };
+
+    static size_t bytesOf(const std::vector<GraphChange>& changes);
+    void evict(uint64_t keep);
+    void startOver(uint64_t root);
+
+    size_t capacity;
+    size_t byteCapacity;
+    size_t bytes; // Sum over nodes
+    std::map<uint64_t, Node> nodes; // Version ids grow, so this is also age order
+};
+
+#endif // GRAPH_HISTORY_H
@@ -3,19 +3,50 @@
 
 #include <vector>
 #include <tuple>
+#include <memory>
+#include "CancellationToken.h"
+#include "TreeIndex.h"
+
+class ThreadPool;
 
 class IMSTSolver {
 public:
     virtual void solve() = 0;
-    virtual int getMSTWeight() const = 0;
+    // Sums and distances are reported as 64-bit regardless of the width the solver was instantiated with
+    virtual long long getMSTWeight() const = 0;
     virtual const std::vector<std::tuple<int, int, int>>& getMSTEdges() const = 0;
 
     // New methods for additional operations
-    virtual int getDiameter() const = 0;
+    virtual long long getDiameter() const = 0;
     virtual double getAverageDistance() const = 0;
-    virtual int getShortestDistance(int xi, int xj) const = 0;
+    // TreeIndex::NO_PATH when xi and xj are not connected, whatever width the solver uses
+    virtual long long getShortestDistance(int xi, int xj) const = 0;
+    // Heaviest edge on the MST path between xi and xj (minimax path weight),
+    // KruskalTree::NO_PATH when they are not connected
+    virtual long long getBottleneck(int xi, int xj) const = 0;
+    // Flat index over the solved tree that the distance metrics above are answered from;
+    // built once per solve and shareable with callers
+    virtual std::shared_ptr<const TreeIndex> getTreeIndex() const = 0;
+
+    // solve() and the metric loops poll this token and throw OperationCancelled once it fires
+    void setCancellationToken(std::shared_ptr<const CancellationToken> token) { cancelToken = std::move(token); }
+    // Pool the tree index of large forests is built on; the caller must not be one of its workers
+    void setThreadPool(ThreadPool* pool) { threadPool = pool; }
 
     virtual ~IMSTSolver() = default;
+
+protected:
+    // Cooperative cancellation point; callers poll it every few thousand steps
+    void checkCancelled() const {
+        if (cancelToken)
+            cancelToken->throwIfCancelled();
+    }
+
+    // Loops poll once per this many steps, keeping clock reads off the hot path
+    static constexpr unsigned CANCEL_CHECK_MASK = 4095;
+
+    std::shared_ptr<const CancellationToken> cancelToken;
+    ThreadPool* threadPool = nullptr;
 };
 
 #endif // IMST_SOLVER_H
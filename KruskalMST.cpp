@@ -1,58 +1,79 @@
 #include "KruskalMST.h"
-
-KruskalMST::KruskalMST(const Graph& graph) : graph(graph), mst_weight(0) {}
-
-void KruskalMST::solve() {
-    int V = graph.getVertices();
-    auto edges = graph.getEdges();
-
-    // Sort edges by weight
-    std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b) {
-        return std::get<2>(a) < std::get<2>(b);
+#include "Trace.h"
+
+template <typename Index>
+KruskalMST<Index>::KruskalMST(const Graph& graph) : graph(graph), mst_weight(0) {}
+
+template <typename Index>
+void KruskalMST<Index>::solve() {
+    TraceSpan span("kruskal.solve", "solver", "edges", static_cast<long long>(graph.getEdges().size()));
+    Index V = static_cast<Index>(graph.getVertices());
+    const auto& graph_edges = graph.getEdges();
+
+    // Copy into the narrow edge layout and sort by weight
+    std::vector<Edge> edges;
+    edges.reserve(graph_edges.size());
+    for (const auto& edge : graph_edges) {
+        edges.push_back({static_cast<Index>(std::get<0>(edge)), static_cast<Index>(std::get<1>(edge)), std::get<2>(edge)});
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.w < b.w;
     });
+    checkCancelled();
 
-    std::vector<int> parent(V);
-    std::vector<int> rank(V, 0);
-    for (int i = 0; i < V; i++)
+    std::vector<Index> parent(V);
+    std::vector<uint8_t> rank(V, 0);
+    for (Index i = 0; i < V; i++)
         parent[i] = i;
 
     mst_edges.clear();
     mst_weight = 0;
+    index.reset();
+
+    // Top reconstruction tree node of each union-find root
+    reconstruction = std::make_unique<KruskalTree>(V);
+    reconstruction_built = false;
+    std::vector<int> top(V);
+    for (Index i = 0; i < V; i++)
+        top[i] = i;
 
+    unsigned steps = 0;
     for (const auto& edge : edges) {
-        int u = std::get<0>(edge);
-        int v = std::get<1>(edge);
-        int weight = std::get<2>(edge);
+        if ((++steps & CANCEL_CHECK_MASK) == 0)
+            checkCancelled();
 
-        int root_u = find(parent, u);
-        int root_v = find(parent, v);
+        Index root_u = find(parent, edge.u);
+        Index root_v = find(parent, edge.v);
 
         if (root_u != root_v) {
-            mst_edges.push_back(edge);
-            mst_weight += weight;
+            mst_edges.emplace_back(edge.u, edge.v, edge.w);
+            mst_weight += edge.w;
+            int node = reconstruction->merge(top[root_u], top[root_v], edge.w);
             Union(parent, rank, root_u, root_v);
+            top[parent[root_u] == root_u ? root_u : root_v] = node;
         }
     }
-
-    // Build MST adjacency list for further calculations
-    buildMSTAdjacencyList();
 }
 
-int KruskalMST::getMSTWeight() const {
+template <typename Index>
+long long KruskalMST<Index>::getMSTWeight() const {
     return mst_weight;
 }
 
-const std::vector<std::tuple<int, int, int>>& KruskalMST::getMSTEdges() const {
+template <typename Index>
+const std::vector<std::tuple<int, int, int>>& KruskalMST<Index>::getMSTEdges() const {
     return mst_edges;
 }
 
-int KruskalMST::find(std::vector<int>& parent, int i) {
+template <typename Index>
+Index KruskalMST<Index>::find(std::vector<Index>& parent, Index i) {
     if (parent[i] != i)
         parent[i] = find(parent, parent[i]);
     return parent[i];
 }
 
-void KruskalMST::Union(std::vector<int>& parent, std::vector<int>& rank, int x, int y) {
+template <typename Index>
+void KruskalMST<Index>::Union(std::vector<Index>& parent, std::vector<uint8_t>& rank, Index x, Index y) {
     if (rank[x] < rank[y])
         parent[x] = y;
     else if (rank[x] > rank[y])
@@ -63,125 +84,41 @@ void KruskalMST::Union(std::vector<int>& parent, std::vector<int>& rank, int x,
     }
 }
 
-void KruskalMST::buildMSTAdjacencyList() const {
-    std::lock_guard<std::mutex> lock(mst_adj_mutex);
-    if (!mst_adj.empty()) return;
-    
-    int V = graph.getVertices();
-    mst_adj.clear();
-    mst_adj.resize(V);
-    for (const auto& edge : mst_edges) {
-        int u = std::get<0>(edge);
-        int v = std::get<1>(edge);
-        int w = std::get<2>(edge);
-        mst_adj[u].emplace_back(v, w);
-        mst_adj[v].emplace_back(u, w);
-    }
+template <typename Index>
+std::shared_ptr<const TreeIndex> KruskalMST<Index>::getTreeIndex() const {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    if (!index)
+        index = std::make_shared<TreeIndex>(graph.getVertices(), mst_edges, std::vector<int>{}, threadPool);
+    return index;
 }
 
-int KruskalMST::getDiameter() const {
-    if (mst_adj.empty())
-        buildMSTAdjacencyList();
-
-    int V = graph.getVertices();
-
-    // BFS function to find farthest node and its distance
-    auto bfs = [&](int start) {
-        std::vector<bool> visited(V, false);
-        std::vector<int> dist(V, 0);
-        std::queue<int> q;
-        q.push(start);
-        visited[start] = true;
-        int farthest_node = start;
-
-        while (!q.empty()) {
-            int u = q.front(); q.pop();
-            for (const auto& neighbor : mst_adj[u]) {
-                int v = neighbor.first;
-                int w = neighbor.second;
-                if (!visited[v]) {
-                    visited[v] = true;
-                    dist[v] = dist[u] + w;
-                    if (dist[v] > dist[farthest_node])
-                        farthest_node = v;
-                    q.push(v);
-                }
-            }
-        }
-        return std::make_pair(farthest_node, dist[farthest_node]);
-    };
-
-    auto [node, _] = bfs(0);
-    auto [farthest_node, max_dist] = bfs(node);
-
-    return max_dist;
+template <typename Index>
+long long KruskalMST<Index>::getDiameter() const {
+    return getTreeIndex()->getDiameter();
 }
 
-double KruskalMST::getAverageDistance() const {
-    if (mst_adj.empty())
-        buildMSTAdjacencyList();
-
-    int V = graph.getVertices();
-    long long total_distance = 0;
-    int pair_count = 0;
-
-    // For all pairs (i, j) where i <= j
-    for (int i = 0; i < V; ++i) {
-        // BFS to compute distances from node i
-        std::vector<int> dist(V, INT_MAX);
-        std::queue<int> q;
-        q.push(i);
-        dist[i] = 0;
-
-        while (!q.empty()) {
-            int u = q.front(); q.pop();
-            for (const auto& neighbor : mst_adj[u]) {
-                int v = neighbor.first;
-                int w = neighbor.second;
-                if (dist[v] == INT_MAX) {
-                    dist[v] = dist[u] + w;
-                    q.push(v);
-                }
-            }
-        }
-
-        for (int j = i; j < V; ++j) {
-            if (dist[j] != INT_MAX) {
-                total_distance += dist[j];
-                pair_count++;
-            }
-        }
-    }
+template <typename Index>
+double KruskalMST<Index>::getAverageDistance() const {
+    return getTreeIndex()->getAverageDistance();
+}
 
-    return static_cast<double>(total_distance) / pair_count;
+template <typename Index>
+long long KruskalMST<Index>::getShortestDistance(int xi, int xj) const {
+    return getTreeIndex()->distance(xi, xj);
 }
 
-int KruskalMST::getShortestDistance(int xi, int xj) const {
-    if (mst_adj.empty())
-        buildMSTAdjacencyList();
-
-    int V = graph.getVertices();
-    std::vector<bool> visited(V, false);
-    std::vector<int> dist(V, INT_MAX);
-    std::queue<int> q;
-    q.push(xi);
-    dist[xi] = 0;
-    visited[xi] = true;
-
-    while (!q.empty()) {
-        int u = q.front(); q.pop();
-        if (u == xj)
-            break;
-        for (const auto& neighbor : mst_adj[u]) {
-            int v = neighbor.first;
-            int w = neighbor.second;
-            if (!visited[v]) {
-                visited[v] = true;
-                dist[v] = dist[u] + w;
-                q.push(v);
-            }
-        }
+template <typename Index>
+long long KruskalMST<Index>::getBottleneck(int xi, int xj) const {
+    std::lock_guard<std::mutex> lock(reconstruction_mutex);
+    if (!reconstruction)
+        return KruskalTree::NO_PATH; // Not solved yet
+    if (!reconstruction_built) {
+        reconstruction->build();
+        reconstruction_built = true;
     }
-
-    return dist[xj];
+    return reconstruction->bottleneck(xi, xj);
 }
+
+// Instantiations dispatched by MSTFactory
+template class KruskalMST<uint16_t>;
+template class KruskalMST<uint32_t>;
@@ -3,40 +3,54 @@
 
 #include "Graph.h"
 #include "IMSTSolver.h"
+#include "KruskalTree.h"
 #include <vector>
 #include <tuple>
 #include <algorithm>
-#include <list>
 #include <queue>
-#include <climits>
+#include <limits>
+#include <cstdint>
 #include <mutex>
 
+// Index is the vertex id type of the internal arrays (see MSTFactory for how it is picked)
+template <typename Index>
 class KruskalMST : public IMSTSolver {
 public:
     KruskalMST(const Graph& graph);
 
     void solve() override;
-    int getMSTWeight() const override;
+    long long getMSTWeight() const override;
     const std::vector<std::tuple<int, int, int>>& getMSTEdges() const override;
 
     // New methods for additional operations
-    int getDiameter() const override;
+    long long getDiameter() const override;
     double getAverageDistance() const override;
-    int getShortestDistance(int xi, int xj) const override;
+    long long getShortestDistance(int xi, int xj) const override;
+    long long getBottleneck(int xi, int xj) const override;
+    std::shared_ptr<const TreeIndex> getTreeIndex() const override;
 
 private:
-    int find(std::vector<int>& parent, int i);
-    void Union(std::vector<int>& parent, std::vector<int>& rank, int x, int y);
+    struct Edge {
+        Index u;
+        Index v;
+        int w;
+    };
 
-    void buildMSTAdjacencyList() const;
+    Index find(std::vector<Index>& parent, Index i);
+    void Union(std::vector<Index>& parent, std::vector<uint8_t>& rank, Index x, Index y);
 
     const Graph& graph;
-    int mst_weight;
+    long long mst_weight;
     std::vector<std::tuple<int, int, int>> mst_edges;
 
-    // MST adjacency list for calculations
-    mutable std::vector<std::list<std::pair<int, int>>> mst_adj;
-    mutable std::mutex mst_adj_mutex;
+    // Tree index over mst_edges, built on the first metric query and shared by all of them
+    mutable std::shared_ptr<const TreeIndex> index;
+    mutable std::mutex index_mutex;
+
+    // Reconstruction tree recorded by solve(); its LCA index is built on first query
+    std::unique_ptr<KruskalTree> reconstruction;
+    mutable bool reconstruction_built = false;
+    mutable std::mutex reconstruction_mutex;
 };
 
-#endif // KRUSKAL_MST_H
\ No newline at end of file
+#endif // KRUSKAL_MST_H
@@ -0,0 +1,65 @@
+#include "KruskalTree.h"
+#include <algorithm>
+
+KruskalTree::KruskalTree(int vertices) : vertices(vertices), weight(vertices, 0), hasParent(vertices, false) {
+    links.reserve(vertices > 0 ? 2 * (vertices - 1) : 0);
+}
+
+std::unique_ptr<KruskalTree> KruskalTree::fromMSTEdges(int vertices, const std::vector<std::tuple<int, int, int>>& edges) {
+    std::vector<std::tuple<int, int, int>> sorted(edges);
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return std::get<2>(a) < std::get<2>(b);
+    });
+
+    // Union-find whose roots remember the top tree node of their set
+    std::vector<int> parent(vertices), top(vertices);
+    for (int i = 0; i < vertices; ++i)
+        parent[i] = top[i] = i;
+    auto find = [&parent](int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+
+    auto tree = std::make_unique<KruskalTree>(vertices);
+    for (const auto& edge : sorted) {
+        int root_u = find(std::get<0>(edge));
+        int root_v = find(std::get<1>(edge));
+        if (root_u == root_v)
+            continue;
+        parent[root_v] = root_u;
+        top[root_u] = tree->merge(top[root_u], top[root_v], std::get<2>(edge));
+    }
+    tree->build();
+    return tree;
+}
+
+int KruskalTree::merge(int a, int b, int w) {
+    int node = static_cast<int>(weight.size());
+    weight.push_back(w);
+    hasParent.push_back(false);
+    hasParent[a] = hasParent[b] = true;
+    links.emplace_back(a, node, 0);
+    links.emplace_back(b, node, 0);
+    return node;
+}
+
+void KruskalTree::build() {
+    // Root every tree at its top node so LCA means "first common merge"
+    std::vector<int> roots;
+    for (int node = static_cast<int>(weight.size()) - 1; node >= vertices; --node)
+        if (!hasParent[node])
+            roots.push_back(node);
+    index = std::make_unique<TreeIndex>(static_cast<int>(weight.size()), links, roots);
+    links.clear();
+    links.shrink_to_fit();
+}
+
+long long KruskalTree::bottleneck(int u, int v) const {
+    if (u == v)
+        return 0;
+    int ancestor = index->lca(u, v);
+    return ancestor < 0 ? NO_PATH : weight[ancestor];
+}
@@ -0,0 +1,41 @@
+#ifndef KRUSKAL_TREE_H
+#define KRUSKAL_TREE_H
+
+#include "TreeIndex.h"
+#include <vector>
+#include <tuple>
+#include <memory>
+#include <climits>
+
+// Kruskal reconstruction tree: leaves are the graph's vertices and every union
+// performed by Kruskal adds an internal node holding the weight of the joining
+// edge. Weights grow towards the root, so the heaviest edge on the MST path
+// between two vertices is the weight of their LCA, answered in O(1).
+class KruskalTree {
+public:
+    // Returned by bottleneck() when the vertices lie in different trees
+    static constexpr long long NO_PATH = LLONG_MIN;
+
+    explicit KruskalTree(int vertices);
+
+    // Builds the tree by replaying Kruskal over already chosen MST edges
+    static std::unique_ptr<KruskalTree> fromMSTEdges(int vertices, const std::vector<std::tuple<int, int, int>>& edges);
+
+    // Joins the sets whose current top nodes are a and b; returns the new node
+    int merge(int a, int b, int w);
+
+    // Builds the LCA index; called once after the last merge
+    void build();
+
+    // Heaviest edge weight on the MST path between u and v (0 when u == v)
+    long long bottleneck(int u, int v) const;
+
+private:
+    int vertices;
+    std::vector<std::tuple<int, int, int>> links; // (child, parent, 0) for TreeIndex
+    std::vector<int> weight;                      // Joining weight per internal node
+    std::vector<bool> hasParent;
+    std::unique_ptr<TreeIndex> index;
+};
+
+#endif // KRUSKAL_TREE_H
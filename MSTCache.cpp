@@ -0,0 +1,81 @@
+#include "MSTCache.h"
+#include "Trace.h"
+
+MSTCache::MSTCache(size_t capacity) : capacity(capacity), uses(0), pool(nullptr) {}
+
+void MSTCache::setThreadPool(ThreadPool* pool) {
+    std::lock_guard<std::mutex> lock(mtx);
+    this->pool = pool;
+}
+
+MSTCache::Entry* MSTCache::lookup(const Graph& graph, uint64_t version, MSTType type, int root, std::shared_ptr<const CancellationToken> token) {
+    if (type != MSTType::EDMONDS)
+        root = 0;
+    TraceSpan span("mst_cache.lookup", "cache", "hit", 0);
+    auto key = std::make_tuple(type, root, version);
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.source->getVersion() == version) {
+        span.setArg(1);
+        it->second.lastUse = ++uses;
+        it->second.solver->setCancellationToken(token);
+        it->second.solver->setThreadPool(pool);
+        return &it->second;
+    }
+
+    // Earlier versions are rebuilt from the history into a standalone graph
+    std::shared_ptr<const Graph> owned;
+    const Graph* source = &graph;
+    if (version != graph.getVersion()) {
+        owned = graph.snapshotAt(version);
+        if (!owned)
+            return nullptr;
+        source = owned.get();
+    }
+
+    std::shared_ptr<IMSTSolver> solver = MSTFactory::createMST(type, *source, root);
+    if (!solver)
+        return nullptr;
+    solver->setCancellationToken(token);
+    solver->setThreadPool(pool);
+    solver->solve();
+    // Only a completed solve is cached
+    Entry& entry = entries[key];
+    entry = Entry{source, owned, solver, nullptr, ++uses};
+
+    while (entries.size() > capacity) {
+        auto oldest = entries.begin();
+        for (auto candidate = entries.begin(); candidate != entries.end(); ++candidate)
+            if (candidate->second.lastUse < oldest->second.lastUse)
+                oldest = candidate;
+        entries.erase(oldest);
+    }
+    return &entries[key];
+}
+
+std::shared_ptr<IMSTSolver> MSTCache::getSolver(const Graph& graph, MSTType type, int root, std::shared_ptr<const CancellationToken> token) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Entry* entry = lookup(graph, graph.getVersion(), type, root, token);
+    return entry ? entry->solver : nullptr;
+}
+
+std::shared_ptr<IMSTSolver> MSTCache::getSolverAt(const Graph& graph, uint64_t version, MSTType type, int root, std::shared_ptr<const CancellationToken> token) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Entry* entry = lookup(graph, version, type, root, token);
+    return entry ? entry->solver : nullptr;
+}
+
+std::shared_ptr<const TreeIndex> MSTCache::getTreeIndex(const Graph& graph, MSTType type, int root, std::shared_ptr<const CancellationToken> token) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Entry* entry = lookup(graph, graph.getVersion(), type, root, token);
+    return entry ? entry->solver->getTreeIndex() : nullptr;
+}
+
+std::shared_ptr<const MSTSensitivity> MSTCache::getSensitivity(const Graph& graph, MSTType type, int root, std::shared_ptr<const CancellationToken> token) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Entry* entry = lookup(graph, graph.getVersion(), type, root, token);
+    if (!entry || entry->source->isDirected())
+        return nullptr;
+    if (!entry->sensitivity)
+        entry->sensitivity = std::make_shared<MSTSensitivity>(*entry->source, entry->solver->getMSTEdges(), token);
+    return entry->sensitivity;
+}
@@ -0,0 +1,58 @@
+#ifndef MST_CACHE_H
+#define MST_CACHE_H
+
+#include "Graph.h"
+#include "MSTFactory.h"
+#include "TreeIndex.h"
+#include "MSTSensitivity.h"
+#include "CancellationToken.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <tuple>
+
+class ThreadPool;
+
+// Solved MSTs keyed by graph version, algorithm and root, so queries against an
+// unchanged graph reuse one solve and its tree index, and moving back to a
+// version (rollback, or undoing a what-if edit) finds its MST still solved.
+// The least recently used entries are evicted beyond capacity.
+class MSTCache {
+public:
+    explicit MSTCache(size_t capacity = 16);
+
+    // Pool the solvers build large tree indexes on; lookups must not run on its workers
+    void setThreadPool(ThreadPool* pool);
+
+    // Solves on a miss; nullptr for an unknown MST type. The returned solver's token is set to token, so callers
+    // should use it from one thread at a time (the active object).
+    // root only matters for EDMONDS.
+    std::shared_ptr<IMSTSolver> getSolver(const Graph& graph, MSTType type, int root, std::shared_ptr<const CancellationToken> token);
+    std::shared_ptr<const TreeIndex> getTreeIndex(const Graph& graph, MSTType type, int root, std::shared_ptr<const CancellationToken> token);
+    // Edge weight tolerances of the current MST; undirected graphs only
+    std::shared_ptr<const MSTSensitivity> getSensitivity(const Graph& graph, MSTType type, int root, std::shared_ptr<const CancellationToken> token);
+    // Same for a retained earlier version, solved on a snapshot without touching the graph;
+    // nullptr also when the version is not retained
+    std::shared_ptr<IMSTSolver> getSolverAt(const Graph& graph, uint64_t version, MSTType type, int root, std::shared_ptr<const CancellationToken> token);
+
+private:
+    struct Entry {
+        const Graph* source;                  // Graph the solver reads; valid while it is at the entry's version
+        std::shared_ptr<const Graph> owned;   // Snapshot of an earlier version, kept alive for the solver
+        std::shared_ptr<IMSTSolver> solver;
+        std::shared_ptr<const MSTSensitivity> sensitivity; // Built on first use
+        uint64_t lastUse;
+    };
+
+    // Returns the entry for a version of the graph, solving if needed
+    Entry* lookup(const Graph& graph, uint64_t version, MSTType type, int root, std::shared_ptr<const CancellationToken> token);
+
+    size_t capacity;
+    uint64_t uses;
+    ThreadPool* pool;
+    std::map<std::tuple<MSTType, int, uint64_t>, Entry> entries;
+    std::mutex mtx;
+};
+
+#endif // MST_CACHE_H
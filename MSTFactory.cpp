@@ -1,10 +1,22 @@
 #include "MSTFactory.h"
+#include "Trace.h"
 
-std::unique_ptr<IMSTSolver> MSTFactory::createMST(MSTType type, const Graph& graph) {
+// 16-bit vertex ids halve the solver's union-find, edge and heap arrays when they fit
+template <template <typename> class Solver>
+static std::unique_ptr<IMSTSolver> createSpecialized(const Graph& graph) {
+    if (graph.getVertices() <= std::numeric_limits<uint16_t>::max())
+        return std::make_unique<Solver<uint16_t>>(graph);
+    return std::make_unique<Solver<uint32_t>>(graph);
+}
+
+std::unique_ptr<IMSTSolver> MSTFactory::createMST(MSTType type, const Graph& graph, int root) {
+    TraceSpan span("mst_factory.create", "factory", "type", static_cast<long long>(type));
     if (type == MSTType::KRUSKAL) {
-        return std::make_unique<KruskalMST>(graph);
-    } else if (type == MSTType::PRIM) {
-        return std::make_unique<PrimMST>(graph);
+        return createSpecialized<KruskalMST>(graph);
+    } else if (type == MSTType::PRIM && !graph.isDirected()) {
+        return createSpecialized<PrimMST>(graph);
+    } else if (type == MSTType::EDMONDS) {
+        return std::make_unique<EdmondsMST>(graph, root);
     }
     return nullptr;
 }
@@ -5,15 +5,19 @@
 #include "IMSTSolver.h"
 #include "KruskalMST.h"
 #include "PrimMST.h"
+#include "EdmondsMST.h"
 
 enum class MSTType {
     KRUSKAL,
-    PRIM
+    PRIM,
+    EDMONDS
 };
 
 class MSTFactory {
 public:
-    static std::unique_ptr<IMSTSolver> createMST(MSTType type, const Graph& graph);
+    // root is only used by EDMONDS (0-based). Kruskal treats a directed graph as
+    // undirected; Prim needs an undirected graph and yields nullptr otherwise.
+    static std::unique_ptr<IMSTSolver> createMST(MSTType type, const Graph& graph, int root = 0);
 };
 
 #endif // MST_FACTORY_H
@@ -0,0 +1,106 @@
+#include "MSTSensitivity.h"
+#include "KruskalTree.h"
+#include <algorithm>
+#include <numeric>
+
+MSTSensitivity::MSTSensitivity(const Graph& graph, const std::vector<std::tuple<int, int, int>>& mstEdges,
+                               std::shared_ptr<const CancellationToken> token) {
+    const int V = graph.getVertices();
+    const auto& edges = graph.getEdges();
+    index.clear();
+    tolerances.resize(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        index.set(std::get<0>(edges[i]), std::get<1>(edges[i]), static_cast<uint32_t>(i));
+        tolerances[i] = Tolerance{false, std::get<2>(edges[i]), 0};
+    }
+
+    // Root every tree of the forest; the edge to a vertex's parent is identified by the vertex
+    std::vector<std::vector<std::pair<int, int>>> children(V);
+    for (const auto& edge : mstEdges) {
+        int u = std::get<0>(edge), v = std::get<1>(edge);
+        children[u].emplace_back(v, std::get<2>(edge));
+        children[v].emplace_back(u, std::get<2>(edge));
+        uint32_t slot = index.find(u, v);
+        if (slot != EdgeIndex::NONE)
+            tolerances[slot] = Tolerance{true, std::get<2>(edge), UNBOUNDED};
+    }
+    std::vector<int> parent(V, -1), depth(V, 0);
+    std::vector<bool> seen(V, false);
+    std::vector<int> queue;
+    queue.reserve(V);
+    for (int root = 0; root < V; ++root) {
+        if (seen[root])
+            continue;
+        seen[root] = true;
+        queue.push_back(root);
+        for (size_t i = queue.size() - 1; i < queue.size(); ++i) {
+            int u = queue[i];
+            for (const auto& next : children[u]) {
+                if (seen[next.first])
+                    continue;
+                seen[next.first] = true;
+                parent[next.first] = u;
+                depth[next.first] = depth[u] + 1;
+                queue.push_back(next.first);
+            }
+        }
+    }
+    children.clear();
+    children.shrink_to_fit();
+
+    // Non-tree edges: heaviest tree edge on their path, from the reconstruction tree
+    auto kruskal = KruskalTree::fromMSTEdges(V, mstEdges);
+    std::vector<uint32_t> nonTree;
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (tolerances[i].inTree)
+            continue;
+        if ((i & 4095) == 0 && token)
+            token->throwIfCancelled();
+        int u = std::get<0>(edges[i]), v = std::get<1>(edges[i]);
+        if (u == v) {
+            tolerances[i].limit = NEVER;
+            continue;
+        }
+        tolerances[i].limit = kruskal->bottleneck(u, v);
+        nonTree.push_back(static_cast<uint32_t>(i));
+    }
+
+    // Tree edges: walk each non-tree edge's path, lightest first, assigning it as the
+    // replacement of every tree edge not yet covered. jump[v] skips to the nearest
+    // ancestor-or-self whose parent edge is still unassigned, so each edge is assigned once.
+    std::sort(nonTree.begin(), nonTree.end(), [&edges](uint32_t a, uint32_t b) {
+        return std::get<2>(edges[a]) < std::get<2>(edges[b]);
+    });
+    std::vector<int> jump(V);
+    std::iota(jump.begin(), jump.end(), 0);
+    auto find = [&jump](int x) {
+        while (jump[x] != x) {
+            jump[x] = jump[jump[x]];
+            x = jump[x];
+        }
+        return x;
+    };
+    for (size_t k = 0; k < nonTree.size(); ++k) {
+        if ((k & 4095) == 0 && token)
+            token->throwIfCancelled();
+        const auto& edge = edges[nonTree[k]];
+        int u = find(std::get<0>(edge)), v = find(std::get<1>(edge));
+        while (u != v) {
+            if (depth[u] < depth[v])
+                std::swap(u, v);
+            uint32_t slot = index.find(u, parent[u]);
+            if (slot != EdgeIndex::NONE)
+                tolerances[slot].limit = std::get<2>(edge);
+            jump[u] = parent[u];
+            u = find(u);
+        }
+    }
+}
+
+bool MSTSensitivity::lookup(int u, int v, Tolerance& out) const {
+    uint32_t slot = index.find(u, v);
+    if (slot == EdgeIndex::NONE)
+        return false;
+    out = tolerances[slot];
+    return true;
+}
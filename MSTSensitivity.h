@@ -0,0 +1,44 @@
+#ifndef MST_SENSITIVITY_H
+#define MST_SENSITIVITY_H
+
+#include "Graph.h"
+#include "EdgeIndex.h"
+#include "CancellationToken.h"
+#include <vector>
+#include <tuple>
+#include <memory>
+#include <climits>
+
+// How far each edge weight can move before the MST (of an undirected graph)
+// changes. A tree edge stays while its weight is at most that of the lightest
+// non-tree edge closing a cycle through it (its replacement); a non-tree edge
+// stays out while its weight is at least the heaviest tree edge on its MST path.
+// Both are computed once after a solve, then looked up in O(1).
+class MSTSensitivity {
+public:
+    // Limit of a tree edge without a replacement (a bridge)
+    static constexpr long long UNBOUNDED = LLONG_MAX;
+    // Limit of a self-loop, which never joins at any weight
+    static constexpr long long NEVER = LLONG_MIN;
+
+    struct Tolerance {
+        bool inTree;
+        int weight;
+        // Tree edge: largest weight that keeps it in the MST (replacement weight, or UNBOUNDED).
+        // Non-tree edge: smallest weight that keeps it out (heaviest edge on its MST path).
+        long long limit;
+    };
+
+    // mstEdges are the 0-based edges of a spanning forest of graph
+    MSTSensitivity(const Graph& graph, const std::vector<std::tuple<int, int, int>>& mstEdges,
+                   std::shared_ptr<const CancellationToken> token = nullptr);
+
+    // 0-based endpoints; false when (u, v) is not an edge of the graph
+    bool lookup(int u, int v, Tolerance& out) const;
+
+private:
+    EdgeIndex index;                 // (u, v) -> position in tolerances
+    std::vector<Tolerance> tolerances;
+};
+
+#endif // MST_SENSITIVITY_H
@@ -1,182 +1,115 @@
 #include "PrimMST.h"
+#include "Trace.h"
 
-PrimMST::PrimMST(const Graph& graph) : graph(graph), mst_weight(0) {}
+template <typename Index>
+PrimMST<Index>::PrimMST(const Graph& graph) : graph(graph), mst_weight(0) {}
 
-void PrimMST::solve() {
-    int V = graph.getVertices();
+template <typename Index>
+void PrimMST<Index>::solve() {
+    TraceSpan span("prim.solve", "solver", "edges", static_cast<long long>(graph.getEdges().size()));
+    const Index none = std::numeric_limits<Index>::max();
+    Index V = static_cast<Index>(graph.getVertices());
     mst_edges.clear();
     mst_weight = 0;
+    index.reset();
+    reconstruction.reset();
 
     std::vector<bool> inMST(V, false);
-    std::vector<int> key(V, INT_MAX);
-    std::vector<int> parent(V, -1);
+    std::vector<int> key(V, std::numeric_limits<int>::max());
+    std::vector<Index> parent(V, none);
 
     // Min-heap priority queue
-    using pii = std::pair<int, int>;
-    std::priority_queue<pii, std::vector<pii>, std::greater<pii>> pq;
+    using entry = std::pair<int, Index>;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> pq;
 
-    // Start from vertex 0
-    key[0] = 0;
-    pq.push({0, 0});
+    const auto& lists = graph.getAdjacencyList();
+    auto compressed = graph.getCompressedAdjacency(); // Set instead of lists in compact mode
 
-    while (!pq.empty()) {
-        int u = pq.top().second;
-        pq.pop();
-
-        if (inMST[u])
+    // Grow one tree from every vertex not yet reached, so a disconnected
+    // graph yields a spanning forest instead of only the tree of vertex 0
+    unsigned steps = 0;
+    for (Index root = 0; root < V; ++root) {
+        if (inMST[root])
             continue;
+        key[root] = 0;
+        pq.push({0, root});
 
-        inMST[u] = true;
+        while (!pq.empty()) {
+            if ((++steps & CANCEL_CHECK_MASK) == 0)
+                checkCancelled();
 
-        if (parent[u] != -1) {
-            // Add edge to MST
-            mst_edges.emplace_back(parent[u], u, key[u]);
-            mst_weight += key[u];
-        }
+            Index u = pq.top().second;
+            pq.pop();
 
-        for (const auto& neighbor : graph.getAdjacencyList()[u]) {
-            int v = neighbor.first;
-            int weight = neighbor.second;
+            if (inMST[u])
+                continue;
 
-            if (!inMST[v] && key[v] > weight) {
-                key[v] = weight;
-                pq.push({key[v], v});
-                parent[v] = u;
+            inMST[u] = true;
+
+            if (parent[u] != none) {
+                // Add edge to MST
+                mst_edges.emplace_back(parent[u], u, key[u]);
+                mst_weight += key[u];
+            }
+
+            auto relax = [&](Index v, int weight) {
+                if (!inMST[v] && key[v] > weight) {
+                    key[v] = weight;
+                    pq.push({key[v], v});
+                    parent[v] = u;
+                }
+            };
+            if (compressed) {
+                compressed->forEachNeighbor(u, relax);
+            } else {
+                for (const auto& neighbor : lists[u])
+                    relax(neighbor.first, neighbor.second);
             }
         }
     }
-
-    // Build MST adjacency list for further calculations
-    buildMSTAdjacencyList();
 }
 
-int PrimMST::getMSTWeight() const {
+template <typename Index>
+long long PrimMST<Index>::getMSTWeight() const {
     return mst_weight;
 }
 
-const std::vector<std::tuple<int, int, int>>& PrimMST::getMSTEdges() const {
+template <typename Index>
+const std::vector<std::tuple<int, int, int>>& PrimMST<Index>::getMSTEdges() const {
     return mst_edges;
 }
 
-void PrimMST::buildMSTAdjacencyList() const {
-    std::lock_guard<std::mutex> lock(mst_adj_mutex);
-    if (!mst_adj.empty()) return;  // Already built
-    
-    int V = graph.getVertices();
-    mst_adj.clear();
-    mst_adj.resize(V);
-    for (const auto& edge : mst_edges) {
-        int u = std::get<0>(edge);
-        int v = std::get<1>(edge);
-        int w = std::get<2>(edge);
-        mst_adj[u].emplace_back(v, w);
-        mst_adj[v].emplace_back(u, w);
-    }
+template <typename Index>
+std::shared_ptr<const TreeIndex> PrimMST<Index>::getTreeIndex() const {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    if (!index)
+        index = std::make_shared<TreeIndex>(graph.getVertices(), mst_edges, std::vector<int>{}, threadPool);
+    return index;
 }
 
-int PrimMST::getDiameter() const {
-    if (mst_adj.empty())
-        buildMSTAdjacencyList();
-
-    int V = graph.getVertices();
-
-    // BFS function to find farthest node and its distance
-    auto bfs = [&](int start) {
-        std::vector<bool> visited(V, false);
-        std::vector<int> dist(V, 0);
-        std::queue<int> q;
-        q.push(start);
-        visited[start] = true;
-        int farthest_node = start;
-
-        while (!q.empty()) {
-            int u = q.front(); q.pop();
-            for (const auto& neighbor : mst_adj[u]) {
-                int v = neighbor.first;
-                int w = neighbor.second;
-                if (!visited[v]) {
-                    visited[v] = true;
-                    dist[v] = dist[u] + w;
-                    if (dist[v] > dist[farthest_node])
-                        farthest_node = v;
-                    q.push(v);
-                }
-            }
-        }
-        return std::make_pair(farthest_node, dist[farthest_node]);
-    };
-
-    auto [node, _] = bfs(0);
-    auto [farthest_node, max_dist] = bfs(node);
-
-    return max_dist;
+template <typename Index>
+long long PrimMST<Index>::getDiameter() const {
+    return getTreeIndex()->getDiameter();
 }
 
-double PrimMST::getAverageDistance() const {
-    if (mst_adj.empty())
-        buildMSTAdjacencyList();
-
-    int V = graph.getVertices();
-    long long total_distance = 0;
-    int pair_count = 0;
-
-    // For all pairs (i, j) where i <= j
-    for (int i = 0; i < V; ++i) {
-        // BFS to compute distances from node i
-        std::vector<int> dist(V, INT_MAX);
-        std::queue<int> q;
-        q.push(i);
-        dist[i] = 0;
-
-        while (!q.empty()) {
-            int u = q.front(); q.pop();
-            for (const auto& neighbor : mst_adj[u]) {
-                int v = neighbor.first;
-                int w = neighbor.second;
-                if (dist[v] == INT_MAX) {
-                    dist[v] = dist[u] + w;
-                    q.push(v);
-                }
-            }
-        }
-
-        for (int j = i; j < V; ++j) {
-            if (dist[j] != INT_MAX) {
-                total_distance += dist[j];
-                pair_count++;
-            }
-        }
-    }
-
-    return static_cast<double>(total_distance) / pair_count;
+template <typename Index>
+double PrimMST<Index>::getAverageDistance() const {
+    return getTreeIndex()->getAverageDistance();
 }
 
-int PrimMST::getShortestDistance(int xi, int xj) const {
-    if (mst_adj.empty())
-        buildMSTAdjacencyList();
-
-    int V = graph.getVertices();
-    std::vector<bool> visited(V, false);
-    std::vector<int> dist(V, INT_MAX);
-    std::queue<int> q;
-    q.push(xi);
-    dist[xi] = 0;
-    visited[xi] = true;
-
-    while (!q.empty()) {
-        int u = q.front(); q.pop();
-        if (u == xj)
-            break;
-        for (const auto& neighbor : mst_adj[u]) {
-            int v = neighbor.first;
-            int w = neighbor.second;
-            if (!visited[v]) {
-                visited[v] = true;
-                dist[v] = dist[u] + w;
-                q.push(v);
-            }
-        }
-    }
+template <typename Index>
+long long PrimMST<Index>::getShortestDistance(int xi, int xj) const {
+    return getTreeIndex()->distance(xi, xj);
+}
 
-    return dist[xj];
+template <typename Index>
+long long PrimMST<Index>::getBottleneck(int xi, int xj) const {
+    std::lock_guard<std::mutex> lock(reconstruction_mutex);
+    if (!reconstruction)
+        reconstruction = KruskalTree::fromMSTEdges(graph.getVertices(), mst_edges);
+    return reconstruction->bottleneck(xi, xj);
 }
+
+// Instantiations dispatched by MSTFactory
+template class PrimMST<uint16_t>;
+template class PrimMST<uint32_t>;
@@ -4,37 +4,44 @@
 
 #include "Graph.h"
 #include "IMSTSolver.h"
+#include "KruskalTree.h"
 #include <vector>
 #include <tuple>
 #include <queue>
 #include <functional>
-#include <climits>
-#include <list>
+#include <limits>
+#include <cstdint>
 #include <mutex>
 
+// Index is the vertex id type of the internal arrays (see MSTFactory for how it is picked)
+template <typename Index>
 class PrimMST : public IMSTSolver {
 public:
     PrimMST(const Graph& graph);
 
     void solve() override;
-    int getMSTWeight() const override;
+    long long getMSTWeight() const override;
     const std::vector<std::tuple<int, int, int>>& getMSTEdges() const override;
 
     // New methods for additional operations
-    int getDiameter() const override;
+    long long getDiameter() const override;
     double getAverageDistance() const override;
-    int getShortestDistance(int xi, int xj) const override;
+    long long getShortestDistance(int xi, int xj) const override;
+    long long getBottleneck(int xi, int xj) const override;
+    std::shared_ptr<const TreeIndex> getTreeIndex() const override;
 
 private:
-    void buildMSTAdjacencyList() const;
-
     const Graph& graph;
-    int mst_weight;
+    long long mst_weight;
     std::vector<std::tuple<int, int, int>> mst_edges;
 
-    // MST adjacency list for calculations
-    mutable std::vector<std::list<std::pair<int, int>>> mst_adj;
-    mutable std::mutex mst_adj_mutex;
+    // Tree index over mst_edges, built on the first metric query and shared by all of them
+    mutable std::shared_ptr<const TreeIndex> index;
+    mutable std::mutex index_mutex;
+
+    // Reconstruction tree, replayed from mst_edges on the first bottleneck query
+    mutable std::unique_ptr<KruskalTree> reconstruction;
+    mutable std::mutex reconstruction_mutex;
 };
 
-#endif // PRIM_MST_H
\ No newline at end of file
+#endif // PRIM_MST_H
@@ -0,0 +1,201 @@
+#include "Reactor.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <system_error>
+#include <algorithm>
+
+namespace {
+
+// Fire-and-forget coroutine that owns a spawned task until it finishes
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+};
+
+Detached runDetached(Task<void> task, size_t* live) {
+    try {
+        co_await task;
+    } catch (...) {
+        // A session failing must not take the reactor down
+    }
+    (*live)--;
+}
+
+} // namespace
+
+Reactor::Reactor() : stopping(false), live(0), nextTimer(1), stopRequested(false) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || eventFd < 0)
+        throw std::system_error(errno, std::generic_category(), "reactor setup");
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = eventFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event);
+}
+
+Reactor::~Reactor() {
+    close(eventFd);
+    close(epollFd);
+}
+
+void Reactor::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(eventFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void Reactor::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(postMtx);
+        posted.push_back(std::move(fn));
+    }
+    wake();
+}
+
+void Reactor::stopWhenIdle() {
+    {
+        std::lock_guard<std::mutex> lock(postMtx);
+        stopRequested = true;
+    }
+    wake();
+}
+
+void Reactor::spawn(Task<void> task) {
+    live++;
+    runDetached(std::move(task), &live);
+}
+
+void Reactor::watch(int fd, uint32_t events, std::function<void(uint32_t)> fn) {
+    watchers[fd] = std::move(fn);
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.fd = fd;
+    // The fd may have been closed and reused since it was last registered
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) < 0 && errno == ENOENT)
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+void Reactor::unwatch(int fd) {
+    if (watchers.erase(fd))
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+uint64_t Reactor::after(Clock::time_point when, std::function<void()> fn) {
+    uint64_t id = nextTimer++;
+    timers.emplace(std::make_pair(when, id), std::move(fn));
+    timerDue.emplace(id, when);
+    return id;
+}
+
+void Reactor::cancel(uint64_t timer) {
+    auto it = timerDue.find(timer);
+    if (it == timerDue.end())
+        return;
+    timers.erase(std::make_pair(it->second, timer));
+    timerDue.erase(it);
+}
+
+void Reactor::runTimers() {
+    Clock::time_point now = Clock::now();
+    while (!timers.empty() && timers.begin()->first.first <= now) {
+        auto fn = std::move(timers.begin()->second);
+        timerDue.erase(timers.begin()->first.second);
+        timers.erase(timers.begin());
+        fn();
+    }
+}
+
+void Reactor::runPosted() {
+    std::vector<std::function<void()>> batch;
+    {
+        std::lock_guard<std::mutex> lock(postMtx);
+        batch.swap(posted);
+        stopping = stopRequested;
+    }
+    for (auto& fn : batch)
+        fn();
+}
+
+void Reactor::run() {
+    epoll_event events[64];
+    while (true) {
+        runPosted();
+        if (stopping && live == 0)
+            return;
+
+        int timeout = -1;
+        if (!timers.empty()) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(timers.begin()->first.first - Clock::now());
+            timeout = static_cast<int>(std::max<long long>(0, std::min<long long>(wait.count(), 60000)));
+        }
+        int n = epoll_wait(epollFd, events, 64, timeout);
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == eventFd) {
+                uint64_t count;
+                ssize_t ignored = read(eventFd, &count, sizeof(count));
+                (void)ignored;
+                continue;
+            }
+            auto it = watchers.find(fd);
+            if (it == watchers.end())
+                continue;
+            // One-shot: the callback may watch the fd again
+            auto fn = std::move(it->second);
+            watchers.erase(it);
+            fn(events[i].events);
+        }
+        runTimers();
+    }
+}
+
+Reactor::Wait::Wait(Reactor& reactor, int fd, uint32_t events, Clock::time_point until,
+                    std::function<void(std::function<void()>)> arm)
+    : reactor(reactor), fd(fd), events(events), until(until), arm(std::move(arm)) {}
+
+void Reactor::Wait::await_suspend(std::coroutine_handle<> handle) {
+    // Whichever source fires first resumes the coroutine and disarms the others
+    struct State {
+        std::coroutine_handle<> handle;
+        bool done = false;
+        int fd = -1;
+        uint64_t timer = 0;
+    };
+    auto state = std::make_shared<State>();
+    state->handle = handle;
+    Reactor* owner = &reactor;
+    auto fire = [owner, state]() {
+        if (state->done)
+            return;
+        state->done = true;
+        if (state->fd >= 0)
+            owner->unwatch(state->fd);
+        if (state->timer)
+            owner->cancel(state->timer);
+        state->handle.resume();
+    };
+
+    if (fd >= 0) {
+        state->fd = fd;
+        reactor.watch(fd, events, [fire](uint32_t) { fire(); });
+    }
+    if (until != Clock::time_point::max())
+        state->timer = reactor.after(until, fire);
+    if (arm)
+        arm([owner, fire]() { owner->post(fire); });
+}
+
+Reactor::Wait Reactor::ready(int fd, uint32_t events) {
+    return Wait(*this, fd, events, Clock::time_point::max(), nullptr);
+}
+
+Reactor::Wait Reactor::completion(std::function<void(std::function<void()>)> start) {
+    return Wait(*this, -1, 0, Clock::time_point::max(), std::move(start));
+}
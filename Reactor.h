@@ -0,0 +1,89 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "Task.h"
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <sys/epoll.h>
+
+// Single-threaded epoll event loop that drives coroutine sessions. A session
+// suspended on a socket, a timer or work running elsewhere holds no thread,
+// only its coroutine frame. Everything except post() must be called on the
+// reactor thread; work finishing on other threads resumes through post().
+class Reactor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    void operator=(const Reactor&) = delete;
+
+    // Runs the loop on the calling thread until stopWhenIdle() and no task is left
+    void run();
+    // Thread-safe: lets run() return once every spawned task has finished
+    void stopWhenIdle();
+    // Thread-safe: runs fn on the reactor thread
+    void post(std::function<void()> fn);
+
+    // Starts a task that nobody awaits; it lives until it finishes
+    void spawn(Task<void> task);
+
+    // One-shot: fn receives the epoll events once fd reports any of events (a new watch replaces the old)
+    void watch(int fd, uint32_t events, std::function<void(uint32_t)> fn);
+    void unwatch(int fd);
+    // One-shot timer; returns an id for cancel()
+    uint64_t after(Clock::time_point when, std::function<void()> fn);
+    void cancel(uint64_t timer);
+
+    // Resumes once fd reports events, or at until, or when the waker handed to arm is
+    // called (from any thread), whichever comes first
+    class Wait {
+    public:
+        Wait(Reactor& reactor, int fd, uint32_t events, Clock::time_point until,
+             std::function<void(std::function<void()>)> arm);
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+
+    private:
+        Reactor& reactor;
+        int fd;
+        uint32_t events;
+        Clock::time_point until;
+        std::function<void(std::function<void()>)> arm;
+    };
+
+    // Wait for socket readiness only
+    Wait ready(int fd, uint32_t events);
+    // Wait for start to call the waker it is given, from any thread
+    Wait completion(std::function<void(std::function<void()>)> start);
+
+private:
+    void wake();
+    void runTimers();
+    void runPosted();
+
+    int epollFd;
+    int eventFd;
+    bool stopping;
+    size_t live; // Spawned tasks not yet finished
+
+    std::unordered_map<int, std::function<void(uint32_t)>> watchers;
+    std::map<std::pair<Clock::time_point, uint64_t>, std::function<void()>> timers;
+    std::unordered_map<uint64_t, Clock::time_point> timerDue;
+    uint64_t nextTimer;
+
+    std::mutex postMtx;
+    std::vector<std::function<void()>> posted;
+    bool stopRequested; // Guarded by postMtx
+};
+
+#endif // REACTOR_H
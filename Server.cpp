@@ -12,178 +12,662 @@
 #include <functional>
 #include <algorithm>
 #include <chrono>
+#include <future>
+#include <fstream>
+#include <cmath>
+#include <climits>
 #include <signal.h> // Include signal handling
+#include <pthread.h>
+#include <memory>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <set>
+#include <deque>
+#include <cerrno>
 #include "Graph.h"
+#include "Reactor.h"
+#include "Task.h"
 #include "MSTFactory.h"
 #include "ActiveObject.h"
 #include "ThreadPool.h"
+#include "SingleFlight.h"
+#include "CancellationToken.h"
+#include "SpanningForest.h"
+#include "ExternalKruskal.h"
+#include "MSTCache.h"
+#include "EuclideanMST.h"
+#include "DistanceSampler.h"
+#include "DistanceDistribution.h"
+#include "SharedEdges.h"
+#include "Trace.h"
 
 #define PORT 9034
 #define MAX_CLIENTS 100
+#define LISTEN_BACKLOG 128 // Pending connections per listener
+#define UNIX_SOCKET_PATH "/tmp/mst_server.sock" // Same protocol for co-located clients, plus memfd bulk transfer
+#define MAX_PASSED_FDS 4 // Descriptors accepted with one read from a local client
+#define FLUSH_BYTES (64 * 1024) // Queued reply bytes that trigger a write even while commands are pipelined
+#define WRITEV_CHUNKS 64 // Replies gathered into one write
+#define GRAPH_HISTORY_VERSIONS 256 // Graph versions kept for rollback and historical MST queries
+#define GRAPH_HISTORY_BYTES (size_t(256) << 20) // Memory those versions may pin, reset snapshots included
+#define COMPACT_GRAPH_EDGES (1 << 22) // Graphs uploaded with this many edges keep their adjacency compressed
+#define EXTERNAL_RUN_EDGES (1 << 22) // Edges per sorted run of the out-of-core Kruskal (48 MiB)
+#define MAX_BATCH_PAIRS (1 << 20) // Pairs accepted by one batch distance query (option 11)
+#define MAX_EUCLIDEAN_POINTS (1 << 22) // Points accepted by one Euclidean MST upload (option 13)
+#define BLOCKING_POOL_THREADS 4 // Most blocking loads run at once
+#define POOL_IDLE_MS 30000 // Pool workers idle this long retire, down to one per pool
+#define TRACE_PATH "/tmp/mst_trace.json" // Where trace dumps (option 22, SIGUSR1) are written
+#define DATA_DIR "mst_data" // The only directory option 10 reads, writes and spills to, under the working directory (MST_DATA_DIR overrides)
 
 std::mutex cout_mutex;
+std::string data_dir; // Canonical DATA_DIR, set once in main before any session starts
 
-// Declare listener_fd globally
-int listener_fd = -1;
-
-// Signal handler function
-void signal_handler(int signal)
+// One client connection. Reads and writes never block: when the socket is not
+// ready the session's coroutine suspends on the reactor instead of holding a thread.
+struct Session
 {
-    if (signal == SIGTERM || signal == SIGINT)
-    { // Include SIGINT
-        if (listener_fd >= 0)
+    Reactor &reactor;
+    int sock;
+    bool local = false; // Unix-domain peer: bulk edge arrays travel as memfds
+    std::string input; // Received but not yet consumed
+    bool skipNewline = false; // A line ended with '\r'; drop a '\n' that follows it
+    std::deque<int> passedFds; // Received with SCM_RIGHTS and not yet taken
+    std::deque<std::string> output; // Replies not yet written
+    size_t outputBytes = 0; // Unwritten bytes in output
+    size_t outputSent = 0;  // Bytes of output.front() already written
+    uint64_t traceId = Trace::newRequestId(); // Trace track for time between requests
+    uint64_t request = 0; // Trace id of the request being served, 0 between requests
+
+    // Track that socket waits are recorded on
+    uint64_t traceTrack() const
+    {
+        return request ? request : traceId;
+    }
+
+    ~Session()
+    {
+        for (int fd : passedFds)
+            close(fd);
+    }
+
+    // Oldest descriptor the peer has passed so far (the caller owns it), or -1
+    int takeFd()
+    {
+        if (passedFds.empty())
+            return -1;
+        int fd = passedFds.front();
+        passedFds.pop_front();
+        return fd;
+    }
+
+    // Reads what is available, keeping any descriptors passed along with it
+    ssize_t receive(char *buffer, size_t size)
+    {
+        if (!local)
+            return recv(sock, buffer, size, 0);
+
+        struct iovec iov = {buffer, size};
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0)
+            return n;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
         {
-            close(listener_fd); // Close the listener socket
-            listener_fd = -1;   // Set to -1 to indicate it's closed
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+                continue;
+            size_t fds = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < fds; ++i)
+            {
+                int fd;
+                memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+                passedFds.push_back(fd);
+            }
         }
+        return n;
     }
-}
 
-// Helper function to read a line from the socket
-std::string recv_line(int sock)
-{
-    std::string line;
-    char c;
-    while (true)
+    // Next line without its terminator ("\n", "\r\n" or "\r"); empty once the peer is gone
+    Task<std::string> recvLine()
     {
-        int bytes_received = recv(sock, &c, 1, 0);
-        if (bytes_received <= 0)
+        TraceSpan span("recv_line", "request", nullptr, 0, traceTrack());
+        while (true)
         {
+            if (skipNewline && !input.empty())
+            {
+                if (input[0] == '\n')
+                    input.erase(0, 1);
+                skipNewline = false;
+            }
+            size_t end = input.find_first_of("\r\n");
+            if (end != std::string::npos)
+            {
+                std::string line = input.substr(0, end);
+                if (input[end] == '\r')
+                {
+                    if (end + 1 < input.size() && input[end + 1] == '\n')
+                        end++;
+                    else if (end + 1 == input.size())
+                        skipNewline = true;
+                }
+                input.erase(0, end + 1);
+                co_return line;
+            }
+
+            char buffer[4096];
+            ssize_t n = receive(buffer, sizeof(buffer));
+            if (n > 0)
+            {
+                input.append(buffer, n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                // Nothing more is pipelined: answer what has been served before waiting
+                if (!output.empty())
+                {
+                    co_await flush();
+                    continue;
+                }
+                co_await reactor.ready(sock, EPOLLIN | EPOLLRDHUP);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
             // Connection closed or error
-            return "";
+            co_return std::string();
         }
-        if (c == '\n')
+    }
+
+    // Queues msg for the next flush. Replies pile up while pipelined commands are
+    // being served and leave in one writev once the session waits for the client.
+    Task<void> send(std::string msg)
+    {
+        if (msg.empty())
+            co_return;
+        outputBytes += msg.size();
+        output.push_back(std::move(msg));
+        if (outputBytes >= FLUSH_BYTES)
+            co_await flush();
+    }
+
+    // Writes all queued replies, suspending while the socket buffer is full; errors drop the rest
+    Task<void> flush()
+    {
+        TraceSpan span("flush", "request", "bytes", static_cast<long long>(outputBytes), traceTrack());
+        while (!output.empty())
         {
-            break;
+            struct iovec iov[WRITEV_CHUNKS];
+            int count = 0;
+            for (auto it = output.begin(); it != output.end() && count < WRITEV_CHUNKS; ++it, ++count)
+            {
+                size_t skip = count == 0 ? outputSent : 0;
+                iov[count].iov_base = const_cast<char *>(it->data()) + skip;
+                iov[count].iov_len = it->size() - skip;
+            }
+            struct msghdr hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_iov = iov;
+            hdr.msg_iovlen = count;
+            ssize_t n = sendmsg(sock, &hdr, MSG_NOSIGNAL);
+            if (n >= 0)
+            {
+                consume(static_cast<size_t>(n));
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                co_await reactor.ready(sock, EPOLLOUT);
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            output.clear();
+            outputBytes = 0;
+            outputSent = 0;
         }
-        else if (c == '\r')
+    }
+
+    // Answers the replies still queued, then closes the socket. A client that pipelined its
+    // commands and half-closed gets every reply before the connection goes away.
+    Task<void> hangUp()
+    {
+        co_await flush();
+        close(sock);
+    }
+
+    // Drops n written bytes from the front of the queue
+    void consume(size_t n)
+    {
+        outputBytes -= n;
+        while (n > 0)
         {
-            // Peek ahead to see if next char is '\n'
-            int peek_bytes = recv(sock, &c, 1, MSG_PEEK);
-            if (peek_bytes > 0 && c == '\n')
+            size_t left = output.front().size() - outputSent;
+            if (n < left)
             {
-                // Consume the '\n'
-                recv(sock, &c, 1, 0);
+                outputSent += n;
+                return;
             }
-            break;
+            n -= left;
+            output.pop_front();
+            outputSent = 0;
+        }
+    }
+
+    // Like send, with fd passed to a local peer alongside the first byte of msg.
+    // Queued replies go out first so the descriptor arrives with this one.
+    Task<void> sendFd(std::string msg, int fd)
+    {
+        co_await flush();
+        while (true)
+        {
+            struct iovec iov = {msg.data(), msg.size()};
+            alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+            struct msghdr hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_iov = &iov;
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = control;
+            hdr.msg_controllen = sizeof(control);
+            struct cmsghdr *c = CMSG_FIRSTHDR(&hdr);
+            c->cmsg_level = SOL_SOCKET;
+            c->cmsg_type = SCM_RIGHTS;
+            c->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+            ssize_t n = sendmsg(sock, &hdr, MSG_NOSIGNAL);
+            if (n >= 0)
+            {
+                std::string rest = msg.substr(n);
+                co_await send(rest);
+                co_return;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                co_await reactor.ready(sock, EPOLLOUT);
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            co_return;
+        }
+    }
+};
+
+// Writes the buffered trace spans to TRACE_PATH as Chrome trace JSON, replacing the file only once
+// it is complete. Returns the number of spans, or -1 if it could not be written.
+long long dump_trace()
+{
+    std::string partial = std::string(TRACE_PATH) + ".tmp";
+    std::ofstream out(partial, std::ios::trunc);
+    if (!out)
+        return -1;
+    size_t spans = Trace::writeJson(out);
+    out.close();
+    if (!out || rename(partial.c_str(), TRACE_PATH) < 0)
+    {
+        unlink(partial.c_str());
+        return -1;
+    }
+    return static_cast<long long>(spans);
+}
+
+// Resolves a client-supplied file name (relative names are taken inside the data directory) to
+// a canonical path that is guaranteed to lie inside it; false otherwise. A file that does not
+// exist yet is checked through its parent directory, so it may only be created directly there.
+bool resolve_data_path(const std::string &name, std::string &resolved)
+{
+    if (data_dir.empty() || name.empty())
+        return false;
+    std::string path = name[0] == '/' ? name : data_dir + "/" + name;
+
+    char canonical[PATH_MAX];
+    if (realpath(path.c_str(), canonical))
+    {
+        resolved = canonical;
+    }
+    else
+    {
+        // A dangling symlink would be followed when the file is created
+        struct stat link;
+        if (errno != ENOENT || lstat(path.c_str(), &link) == 0)
+            return false;
+        size_t slash = path.rfind('/');
+        std::string file = path.substr(slash + 1);
+        if (file.empty() || file == "." || file == ".." || !realpath(path.substr(0, slash).c_str(), canonical))
+            return false;
+        resolved = std::string(canonical) + "/" + file;
+    }
+    return resolved.size() > data_dir.size() && resolved.compare(0, data_dir.size(), data_dir) == 0 &&
+           resolved[data_dir.size()] == '/';
+}
+
+// Cache key of a query against the MST computed with the given algorithm (and arborescence root)
+std::string mst_key(MSTType type, int root, const std::string &query)
+{
+    return std::to_string(static_cast<int>(type)) + "@" + std::to_string(root) + ":" + query;
+}
+
+// Rough step counts used to pick an active object lane for a query
+size_t solve_cost(Graph *graph)
+{
+    return graph->getVertices() + graph->getEdgeCount();
+}
+
+size_t all_pairs_cost(Graph *graph)
+{
+    size_t v = graph->getVertices();
+    return solve_cost(graph) + v * v;
+}
+
+// Runs a task on the active object and suspends until the reply it produces is ready.
+// Mutations are sent untagged so they share the interactive lane and stay in order.
+// request is the trace id the task runs under.
+Task<std::string> run_on_ao(Reactor &reactor, ActiveObject &ao, std::function<std::string()> task, uint64_t request)
+{
+    std::string result;
+    // Named rather than a temporary inside co_await: GCC 12 destroys lambda temporaries there twice
+    Reactor::Wait done = reactor.completion([&ao, &result, &task, request](std::function<void()> resume)
+                                            { Trace::RequestScope scope(request);
+                                              ao.send([&result, &task, resume]()
+                                                      {
+                                                          result = task();
+                                                          resume(); }); });
+    co_await done;
+    co_return result;
+}
+
+// Runs blocking work (file I/O, long single-threaded solves) on a pool and suspends until it finishes;
+// its exception, if any, is rethrown here
+Task<void> run_blocking(Reactor &reactor, ThreadPool &pool, std::function<void()> work, uint64_t request)
+{
+    std::exception_ptr error;
+    Reactor::Wait done = reactor.completion([&pool, &error, &work, request](std::function<void()> resume)
+                                            { Trace::RequestScope scope(request);
+                                              pool.enqueue([&error, &work, resume]()
+                                                           {
+                                                               try {
+                                                                   work();
+                                                               } catch (...) {
+                                                                   error = std::current_exception();
+                                                               }
+                                                               resume(); }); });
+    co_await done;
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// What the socket shows of the peer, without consuming pending input
+enum class Peer
+{
+    OPEN,
+    END_OF_INPUT, // Closed, or only half-closed and still reading replies; the two look alike
+    GONE          // Socket error
+};
+
+Peer peek_peer(int sock)
+{
+    char c;
+    ssize_t n = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0)
+        return Peer::END_OF_INPUT;
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        return Peer::GONE;
+    return Peer::OPEN;
+}
+
+using Query = std::function<std::string(std::shared_ptr<const CancellationToken>)>;
+
+// Like run_on_ao, but identical queries against the same graph version share one computation.
+// Suspends on behalf of one client until the reply is ready, its timeout (0 = none) expires,
+// or it disconnects. Returns false in the last case.
+Task<bool> run_coalesced(Session &session, ActiveObject &ao, SingleFlight &flights, Graph *graph, std::string key,
+                         size_t cost, std::chrono::milliseconds timeout, Query task, std::string &reply)
+{
+    using Clock = CancellationToken::Clock;
+    Clock::time_point deadline = timeout.count() > 0 ? Clock::now() + timeout : Clock::time_point::max();
+    TraceSpan span("await_result", "request", nullptr, 0, session.request);
+
+    // Input that had already ended when the request started came with it: the client pipelined its
+    // commands and half-closed, and still reads the replies
+    bool halfClosed = peek_peer(session.sock) == Peer::END_OF_INPUT;
+
+    uint64_t request = session.request;
+    auto flight = flights.run(graph->getVersion(), key, deadline, [&ao, &flights, graph, cost, task, request](std::shared_ptr<SingleFlight::Flight> flight)
+                              { Trace::RequestScope scope(request);
+                                ao.send([&flights, graph, flight, task]()
+                                        {
+                                            // Mutations also run on the active object, so this is the version the task reads
+                                            flights.computedOn(flight, graph->getVersion());
+                                            try {
+                                                flight->complete(task(flight->token));
+                                            } catch (...) {
+                                                flight->fail(std::current_exception());
+                                            } },
+                                        cost, flight->token, [flight]()
+                                        { flight->fail(std::make_exception_ptr(OperationCancelled())); }); });
+
+    // Woken by the result, the deadline, or the peer hanging up (pipelined input does not wake it)
+    while (flight->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        // End of input means a hang-up only once it arrives while we wait and nothing pipelined is left
+        Peer peer = peek_peer(session.sock);
+        if (peer == Peer::GONE || (peer == Peer::END_OF_INPUT && !halfClosed && session.input.empty()))
+        {
+            flight->leave();
+            co_return false;
+        }
+        if (Clock::now() >= deadline)
+        {
+            flight->leave();
+            reply = "Request timed out.\n";
+            co_return true;
         }
-        line += c;
+        // After end of input the socket stays readable, so only the result or the deadline can wake us
+        int watched = peer == Peer::END_OF_INPUT ? -1 : session.sock;
+        Reactor::Wait woken(session.reactor, watched, EPOLLRDHUP, deadline, [flight](std::function<void()> resume)
+                            { flight->onReady(resume); });
+        co_await woken;
     }
-    return line;
+    flight->leave();
+
+    try
+    {
+        reply = flight->result.get();
+    }
+    catch (const OperationCancelled &)
+    {
+        reply = "Request cancelled.\n";
+    }
+    co_return true;
 }
 
-// Function to handle each client connection
-void handle_client(int client_sock, ActiveObject &ao)
+// Function to handle each client connection, as a coroutine on the reactor thread.
+// Lambdas and conditional expressions are evaluated into named locals before a
+// co_await: GCC 12 destroys such temporaries there twice.
+Task<void> handle_client(Reactor &reactor, int client_sock, bool local, ActiveObject &ao, SingleFlight &flights, ThreadPool &threadPool, ThreadPool &computePool,
+                         MSTCache &mstCache)
 {
+    Session session{reactor, client_sock, local};
     std::string response;
     Graph *graph = Graph::getInstance();
     MSTType mstType = MSTType::KRUSKAL; // Default MST algorithm
+    int mstRoot = 0;                    // Arborescence root for Edmonds (0-based)
+    std::chrono::milliseconds request_timeout(0); // Per-request deadline, 0 = none
+    bool show_menu = true; // "menu off" stops resending the menu after every reply
 
-    auto send_response = [client_sock](const std::string &msg)
-    {
-        send(client_sock, msg.c_str(), msg.length(), 0);
-    };
-
-    send_response("Do you prefer to use Kruskal or Prim for MST computation?\n");
+    co_await session.send("Do you prefer to use Kruskal or Prim for MST computation? (or 'edmonds [root]' for a minimum arborescence of a directed graph)\n");
 
-    std::string cmd = recv_line(client_sock);
+    std::string cmd = co_await session.recvLine();
     if (cmd.empty())
     {
-        close(client_sock);
-        return;
+        co_await session.hangUp();
+        co_return;
     }
 
     std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
-    if (cmd == "kruskal")
+    std::istringstream algorithm_iss(cmd);
+    std::string algorithm;
+    algorithm_iss >> algorithm;
+    if (algorithm == "edmonds")
+    {
+        int root = 1;
+        algorithm_iss >> root;
+        mstType = MSTType::EDMONDS;
+        mstRoot = root - 1;
+        co_await session.send("MST algorithm set to Edmonds (arborescence rooted at " + std::to_string(root) + ").\n");
+    }
+    else if (cmd == "kruskal")
     {
         mstType = MSTType::KRUSKAL;
-        send_response("MST algorithm set to Kruskal.\n");
+        co_await session.send("MST algorithm set to Kruskal.\n");
     }
     else if (cmd == "prim")
     {
         mstType = MSTType::PRIM;
-        send_response("MST algorithm set to Prim.\n");
+        co_await session.send("MST algorithm set to Prim.\n");
     }
     else
     {
-        send_response("Unknown MST algorithm. Defaulting to Kruskal.\n");
+        co_await session.send("Unknown MST algorithm. Defaulting to Kruskal.\n");
     }
 
     while (true)
     {
+        session.request = 0;
         bool graph_exists = graph->isInitialized();
 
         if (!graph_exists)
         {
-            send_response("Please write the amount of vertices and edges that you want in the graph (format: vertices edges):\n");
+            co_await session.send("Please write the amount of vertices and edges that you want in the graph (format: vertices edges [directed]):\n");
 
-            cmd = recv_line(client_sock);
+            cmd = co_await session.recvLine();
             if (cmd.empty())
             {
-                close(client_sock);
-                return;
+                co_await session.hangUp();
+                co_return;
             }
 
             std::istringstream iss(cmd);
             int v, e;
-            if (!(iss >> v >> e))
+            std::string mode;
+            if (!(iss >> v >> e) || ((iss >> mode) && mode != "directed"))
             {
-                send_response("Invalid input. Please try again.\n");
+                co_await session.send("Invalid input. Please try again.\n");
                 continue;
             }
+            bool directed = mode == "directed";
 
-            send_response("Enter the edges (format: u v weight):\n");
+            if (session.local)
+                co_await session.send("Enter the edges (format: u v weight, or 'memfd' with a sealed edge buffer attached):\n");
+            else
+                co_await session.send("Enter the edges (format: u v weight):\n");
 
             std::vector<std::tuple<int, int, int>> edges;
+            std::shared_ptr<SharedEdges> shared; // Mapped upload from a local client, read in place
             for (int i = 0; i < e; ++i)
             {
-                std::string edge_cmd = recv_line(client_sock);
+                std::string edge_cmd = co_await session.recvLine();
                 if (edge_cmd.empty())
                 {
-                    close(client_sock);
-                    return;
+                    co_await session.hangUp();
+                    co_return;
+                }
+
+                if (session.local && i == 0 && edge_cmd == "memfd")
+                {
+                    std::string error;
+                    int fd = session.takeFd();
+                    if (fd < 0)
+                        error = "no descriptor was passed";
+                    else
+                    {
+                        try
+                        {
+                            shared = std::make_shared<SharedEdges>(fd);
+                        }
+                        catch (const std::exception &ex)
+                        {
+                            error = ex.what();
+                        }
+                        close(fd);
+                    }
+                    if (shared && shared->size() != static_cast<size_t>(e))
+                        error = "edge buffer holds " + std::to_string(shared->size()) + " edges, expected " + std::to_string(e);
+                    for (size_t k = 0; shared && error.empty() && k < shared->size(); ++k)
+                    {
+                        const SharedEdges::Edge &edge = (*shared)[k];
+                        if (edge.u < 1 || edge.u > v || edge.v < 1 || edge.v > v)
+                            error = "edge " + std::to_string(k + 1) + " has a vertex outside 1.." + std::to_string(v);
+                    }
+                    if (!error.empty())
+                    {
+                        shared.reset();
+                        std::string reply = "Invalid edge buffer: " + error + ". Please try again.\n";
+                        co_await session.send(reply);
+                        --i;
+                        continue;
+                    }
+                    break;
                 }
 
                 std::istringstream edge_iss(edge_cmd);
                 int u, v_edge, w;
                 if (!(edge_iss >> u >> v_edge >> w))
                 {
-                    send_response("Invalid edge input. Please try again.\n");
+                    co_await session.send("Invalid edge input. Please try again.\n");
                     --i;
                     continue;
                 }
                 edges.emplace_back(u, v_edge, w);
             }
 
-            ao.send([v, e, edges, &response, graph]()
-                    {
-                graph->newGraph(v, e);
+            auto task = [v, e, directed, edges, shared, graph]()
+            {
+                Graph::Batch batch(*graph);
+                graph->newGraph(v, e, directed);
                 for (const auto& edge : edges) {
                     int u = std::get<0>(edge);
                     int v_edge = std::get<1>(edge);
                     int w = std::get<2>(edge);
                     graph->newEdge(u, v_edge, w);
                 }
-                response = "Graph created successfully.\n"; });
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if (shared) {
+                    for (size_t i = 0; i < shared->size(); ++i) {
+                        const SharedEdges::Edge& edge = (*shared)[i];
+                        graph->newEdge(edge.u, edge.v, edge.w);
+                    }
+                }
+                return std::string("Graph created successfully.\n");
+            };
+            response = co_await run_on_ao(reactor, ao, task, session.request);
 
-            ao.send([&response, graph, mstType]()
-                    {
-                auto mstSolver = MSTFactory::createMST(mstType, *graph);
+            auto query = [graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+            {
+                auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
                 if (mstSolver) {
-                    mstSolver->solve();
-                    response = "MST calculated successfully.\n";
-                } else {
-                    response = "Failed to calculate MST.\n";
-                } });
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    return std::string("MST calculated successfully.\n");
+                }
+                return std::string("Failed to calculate MST.\n");
+            };
+            if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "solve"), solve_cost(graph), request_timeout, query, response))
+            {
+                co_await session.hangUp();
+                co_return;
+            }
 
-            send_response("Graph and MST are ready.\n");
+            co_await session.send("Graph and MST are ready.\n");
         }
 
         std::string menu = "Please choose an operation:\n"
@@ -194,78 +678,134 @@ void handle_client(int client_sock, ActiveObject &ao)
                            "5. Add edge\n"
                            "6. Remove edge\n"
                            "7. New graph\n"
+                           "8. Set request deadline\n"
+                           "9. Spanning forest summary (per connected component)\n"
+                           "10. Load graph from edge file (out-of-core MST)\n"
+                           "11. Batch shortest distances\n"
+                           "12. Heaviest edge on the MST path between two vertices\n"
+                           "13. Load point set (Euclidean MST)\n"
+                           "14. Approximate average distance and percentiles (sampling)\n"
+                           "15. Exact distance distribution (histogram and percentiles)\n"
+                           "16. Version history\n"
+                           "17. Roll back to a version\n"
+                           "18. MST weight at an earlier version\n"
+                           "19. Edge weight tolerance (how far it can change before the MST does)\n"
+                           "20. MST edge list\n"
+                           "21. All metrics (weight, longest and average distance)\n"
+                           "22. Tracing (on, off, or dump to " TRACE_PATH ")\n"
+                           "('menu off' stops showing this menu)\n"
                            "Enter the number of the operation:\n";
-        send_response(menu);
+        if (show_menu)
+            co_await session.send(menu);
 
-        cmd = recv_line(client_sock);
+        cmd = co_await session.recvLine();
         if (cmd.empty())
         {
-            close(client_sock);
-            return;
+            co_await session.hangUp();
+            co_return;
+        }
+
+        // Pipelining clients can drop the menu and rely on the operation numbers
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+        if (cmd == "menu off" || cmd == "menu on")
+        {
+            show_menu = cmd == "menu on";
+            if (show_menu)
+                co_await session.send("Menu enabled.\n");
+            else
+                co_await session.send("Menu disabled.\n");
+            continue;
         }
 
-        int operation;
+        int operation = 0;
+        bool numeric = true;
         try
         {
             operation = std::stoi(cmd);
         }
         catch (const std::exception &)
         {
-            send_response("Invalid input. Please enter a number.\n");
+            numeric = false; // Replied to below: handlers cannot co_await
+        }
+        if (!numeric)
+        {
+            co_await session.send("Invalid input. Please enter a number.\n");
             continue;
         }
 
+        // Everything the operation waits on is traced on its own request track
+        session.request = Trace::newRequestId();
+        TraceSpan request_span("request", "request", "operation", operation, session.request);
+
         switch (operation)
         {
         case 1: // Total weight of MST
-            ao.send([client_sock, &response, graph, mstType, &send_response]()
-                    {
-                    auto mstSolver = MSTFactory::createMST(mstType, *graph);
+            {
+                auto query = [graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
                     if (mstSolver) {
-                        mstSolver->solve();
-                        int weight = mstSolver->getMSTWeight();
-                        response = "Total weight of MST: " + std::to_string(weight) + "\n";
-                    } else {
-                        response = "MST algorithm not set or invalid.\n";
+                        long long weight = mstSolver->getMSTWeight();
+                        return "Total weight of MST: " + std::to_string(weight) + "\n";
                     }
-                    send_response(response); });
+                    return std::string("MST algorithm not set or invalid.\n");
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "weight"), solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
             break;
 
         case 2: // Longest distance between two vertices
-            ao.send([client_sock, &response, graph, mstType, &send_response]()
-                    {
-                    auto mstSolver = MSTFactory::createMST(mstType, *graph);
+            {
+                auto query = [graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
                     if (mstSolver) {
-                        mstSolver->solve();
-                        int diameter = mstSolver->getDiameter();
-                        response = "Longest distance in MST: " + std::to_string(diameter) + "\n";
-                    } else {
-                        response = "MST algorithm not set or invalid.\n";
+                        long long diameter = mstSolver->getDiameter();
+                        return "Longest distance in MST: " + std::to_string(diameter) + "\n";
                     }
-                    send_response(response); });
+                    return std::string("MST algorithm not set or invalid.\n");
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "diameter"), solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
             break;
 
         case 3: // Average distance between any two vertices in the MST
-            ao.send([client_sock, &response, graph, mstType, &send_response]()
-                    {
-                    auto mstSolver = MSTFactory::createMST(mstType, *graph);
+            {
+                auto query = [graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
                     if (mstSolver) {
-                        mstSolver->solve();
                         double avg_distance = mstSolver->getAverageDistance();
-                        response = "Average distance in MST: " + std::to_string(avg_distance) + "\n";
-                    } else {
-                        response = "MST algorithm not set or invalid.\n";
+                        return "Average distance in MST: " + std::to_string(avg_distance) + "\n";
                     }
-                    send_response(response); });
+                    return std::string("MST algorithm not set or invalid.\n");
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "average"), all_pairs_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
             break;
 
         case 4: // Shortest distance between two vertices Xi, Xj
-            send_response("Enter two vertices Xi and Xj:\n");
-            cmd = recv_line(client_sock);
+            co_await session.send("Enter two vertices Xi and Xj:\n");
+            cmd = co_await session.recvLine();
             if (cmd.empty())
             {
-                close(client_sock);
-                return;
+                co_await session.hangUp();
+                co_return;
             }
 
             {
@@ -273,31 +813,39 @@ void handle_client(int client_sock, ActiveObject &ao)
                 int xi, xj;
                 if (!(iss >> xi >> xj))
                 {
-                    send_response("Invalid input. Please enter two integers.\n");
+                    co_await session.send("Invalid input. Please enter two integers.\n");
                     break;
                 }
 
-                ao.send([xi, xj, client_sock, &response, graph, mstType, &send_response]()
-                        {
-                        auto mstSolver = MSTFactory::createMST(mstType, *graph);
-                        if (mstSolver) {
-                            mstSolver->solve();
-                            int shortest_distance = mstSolver->getShortestDistance(xi - 1, xj - 1);
-                            response = "Shortest distance between " + std::to_string(xi) + " and " + std::to_string(xj) + " in MST: " + std::to_string(shortest_distance) + "\n";
-                        } else {
-                            response = "MST algorithm not set or invalid.\n";
-                        }
-                        send_response(response); });
+                std::string key = mst_key(mstType, mstRoot, "shortest " + std::to_string(xi) + " " + std::to_string(xj));
+                auto query = [xi, xj, graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
+                    if (mstSolver) {
+                        if (xi < 1 || xi > graph->getVertices() || xj < 1 || xj > graph->getVertices())
+                            return std::string("Invalid vertices.\n");
+                        long long shortest_distance = mstSolver->getShortestDistance(xi - 1, xj - 1);
+                        std::string distance = shortest_distance == TreeIndex::NO_PATH ? "unreachable" : std::to_string(shortest_distance);
+                        return "Shortest distance between " + std::to_string(xi) + " and " + std::to_string(xj) + " in MST: " + distance + "\n";
+                    }
+                    return std::string("MST algorithm not set or invalid.\n");
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, key, solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
             }
             break;
 
         case 5: // Add edge
-            send_response("Enter the edge to add (format: u v weight):\n");
-            cmd = recv_line(client_sock);
+            co_await session.send("Enter the edge to add (format: u v weight):\n");
+            cmd = co_await session.recvLine();
             if (cmd.empty())
             {
-                close(client_sock);
-                return;
+                co_await session.hangUp();
+                co_return;
             }
 
             {
@@ -305,31 +853,30 @@ void handle_client(int client_sock, ActiveObject &ao)
                 int u, v_edge, w;
                 if (!(iss >> u >> v_edge >> w))
                 {
-                    send_response("Invalid input. Please enter three integers.\n");
+                    co_await session.send("Invalid input. Please enter three integers.\n");
                     break;
                 }
 
-                ao.send([u, v_edge, w, client_sock, &response, graph, mstType, &send_response]()
-                        {
-                        graph->newEdge(u, v_edge, w);
-                        auto mstSolver = MSTFactory::createMST(mstType, *graph);
-                        if (mstSolver) {
-                            mstSolver->solve();
-                            response = "Edge added and MST updated successfully.\n";
-                        } else {
-                            response = "Failed to update MST.\n";
-                        }
-                        send_response(response); });
+                auto task = [u, v_edge, w, graph, mstType, mstRoot, &mstCache]()
+                {
+                    graph->newEdge(u, v_edge, w);
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, nullptr);
+                    if (mstSolver) {
+                        return std::string("Edge added and MST updated successfully.\n");
+                    }
+                    return std::string("Failed to update MST.\n");
+                };
+                co_await session.send(co_await run_on_ao(reactor, ao, task, session.request));
             }
             break;
 
         case 6: // Remove edge
-            send_response("Enter the edge to remove (format: u v):\n");
-            cmd = recv_line(client_sock);
+            co_await session.send("Enter the edge to remove (format: u v):\n");
+            cmd = co_await session.recvLine();
             if (cmd.empty())
             {
-                close(client_sock);
-                return;
+                co_await session.hangUp();
+                co_return;
             }
 
             {
@@ -337,106 +884,1072 @@ void handle_client(int client_sock, ActiveObject &ao)
                 int u, v_edge;
                 if (!(iss >> u >> v_edge))
                 {
-                    send_response("Invalid input. Please enter two integers.\n");
+                    co_await session.send("Invalid input. Please enter two integers.\n");
                     break;
                 }
 
-                ao.send([u, v_edge, client_sock, &response, graph, mstType, &send_response]()
-                        {
-                        graph->removeEdge(u, v_edge);
-                        auto mstSolver = MSTFactory::createMST(mstType, *graph);
-                        if (mstSolver) {
-                            mstSolver->solve();
-                            response = "Edge removed and MST updated successfully.\n";
-                        } else {
-                            response = "Failed to update MST.\n";
-                        }
-                        send_response(response); });
+                auto task = [u, v_edge, graph, mstType, mstRoot, &mstCache]()
+                {
+                    graph->removeEdge(u, v_edge);
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, nullptr);
+                    if (mstSolver) {
+                        return std::string("Edge removed and MST updated successfully.\n");
+                    }
+                    return std::string("Failed to update MST.\n");
+                };
+                co_await session.send(co_await run_on_ao(reactor, ao, task, session.request));
             }
             break;
 
         case 7: // New graph
-            ao.send([&graph]()
-                    { graph->newGraph(0, 0); });
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            send_response("Graph has been reset. Please create a new graph.\n");
+            {
+                auto task = [graph]()
+                {
+                    graph->newGraph(0, 0);
+                    return std::string();
+                };
+                co_await run_on_ao(reactor, ao, task, session.request);
+                co_await session.send("Graph has been reset. Please create a new graph.\n");
+            }
             break;
 
-        default:
-            send_response("Invalid operation selected.\n");
-            break;
-        }
+        case 8: // Per-request deadline for this session
+            co_await session.send("Enter the deadline in milliseconds (0 for none):\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-}
+            {
+                std::istringstream iss(cmd);
+                long long ms;
+                if (!(iss >> ms) || ms < 0)
+                {
+                    co_await session.send("Invalid input. Please enter a non-negative integer.\n");
+                    break;
+                }
+                request_timeout = std::chrono::milliseconds(ms);
+                response = ms == 0 ? "Request deadline cleared.\n" : "Request deadline set to " + std::to_string(ms) + " ms.\n";
+                co_await session.send(response);
+            }
+            break;
 
-int main()
-{
-    int client_fd;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t addr_size;
+        case 9: // Per-component spanning forest metrics
+            if (mstType == MSTType::EDMONDS)
+            {
+                co_await session.send("Spanning forest summary is only available for Kruskal and Prim.\n");
+                break;
+            }
+            {
+                auto query = [graph, mstType, &computePool](std::shared_ptr<const CancellationToken> token)
+                {
+                    if (mstType == MSTType::PRIM && graph->isDirected())
+                        return std::string("MST algorithm not set or invalid.\n");
+                    SpanningForest forest(*graph, mstType, computePool);
+                    forest.setCancellationToken(token);
+                    forest.solve();
 
-    // Register signal handler for SIGTERM and SIGINT
-    signal(SIGTERM, signal_handler);
-    signal(SIGINT, signal_handler); // Handle Ctrl+C gracefully
+                    const auto& components = forest.getComponents();
+                    std::ostringstream out;
+                    out << "Spanning forest: " << components.size() << " components, total weight " << forest.getTotalWeight() << "\n";
+                    int isolated = 0;
+                    for (size_t c = 0; c < components.size(); ++c) {
+                        if (components[c].vertices == 1) {
+                            isolated++;
+                            continue;
+                        }
+                        out << "Component " << c + 1 << ": " << components[c].vertices << " vertices, weight " << components[c].weight
+                            << ", longest distance " << components[c].diameter << ", average distance " << std::to_string(components[c].averageDistance) << "\n";
+                    }
+                    if (isolated > 0)
+                        out << isolated << " isolated vertices\n";
+                    return out.str();
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "forest"), all_pairs_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
 
-    listener_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listener_fd < 0)
-    {
-        perror("Socket error");
-        exit(1);
-    }
+        case 10: // Out-of-core Kruskal over an edge file, keeping only the resulting tree
+            co_await session.send("Enter the edge file and the output file for the MST edges, inside " + data_dir + " (format: input output):\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
 
-    // Set socket options to reuse address and port
-    int opt = 1;
-    setsockopt(listener_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt));
+            {
+                std::istringstream iss(cmd);
+                std::string input_name, output_name, input_path, output_path;
+                if (!(iss >> input_name >> output_name))
+                {
+                    co_await session.send("Invalid input. Please enter two paths.\n");
+                    break;
+                }
+                // Files are opened with the server's privileges, so clients are confined to the data directory
+                if (!resolve_data_path(input_name, input_path) || !resolve_data_path(output_name, output_path))
+                {
+                    co_await session.send("Both files must be inside " + data_dir + ".\n");
+                    break;
+                }
+                if (input_path == output_path)
+                {
+                    co_await session.send("The output file must differ from the input file.\n");
+                    break;
+                }
 
-    // Bind
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(PORT);
+                // The sort and merge only touch files, so they run on the blocking pool;
+                // just installing the tree goes through the active object
+                ExternalKruskal external(data_dir, EXTERNAL_RUN_EDGES);
+                auto token = std::make_shared<CancellationToken>();
+                if (request_timeout.count() > 0)
+                    token->setDeadline(CancellationToken::Clock::now() + request_timeout);
+                external.setCancellationToken(token);
+                std::string failure;
+                try
+                {
+                    auto work = [&external, input_path, output_path]()
+                    {
+                        external.solve(input_path, output_path);
+                    };
+                    co_await run_blocking(reactor, threadPool, work, session.request);
+                }
+                catch (const OperationCancelled &)
+                {
+                    failure = "Request timed out.\n";
+                }
+                catch (const std::exception &e)
+                {
+                    failure = std::string("Failed to compute MST: ") + e.what() + "\n";
+                }
+                if (!failure.empty())
+                {
+                    co_await session.send(failure);
+                    break;
+                }
+
+                auto task = [graph, output_path]()
+                {
+                    std::ifstream tree(output_path);
+                    int v;
+                    size_t e;
+                    if (!(tree >> v >> e))
+                        return std::string("Failed to load MST edges from " + output_path + ".\n");
+                    Graph::Batch batch(*graph);
+                    graph->newGraph(v, static_cast<int>(e));
+                    int u, v_edge, w;
+                    while (tree >> u >> v_edge >> w)
+                        graph->newEdge(u, v_edge, w);
+                    return std::string("MST loaded as the current graph.\n");
+                };
+                co_await session.send(co_await run_on_ao(reactor, ao, task, session.request));
+                co_await session.send("MST of " + std::to_string(external.getVertices()) + " vertices: " + std::to_string(external.getMSTEdgeCount()) +
+                              " edges, total weight " + std::to_string(external.getMSTWeight()) + ", " +
+                              std::to_string(external.getRunCount()) + " sorted runs, written to " + output_path + "\n");
+            }
+            break;
+
+        case 11: // Many (Xi, Xj) pairs answered against one solved MST
+            co_await session.send("Enter the number of pairs, then the pairs (format: Xi Xj, any number per line):\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                // Parsed signed, so "-1" is rejected instead of wrapping to a huge size
+                long long requested;
+                std::istringstream count_iss(cmd);
+                if (!(count_iss >> requested) || requested < 0)
+                {
+                    co_await session.send("Invalid input. Please enter the number of pairs.\n");
+                    break;
+                }
+                if (requested > MAX_BATCH_PAIRS)
+                {
+                    co_await session.send("Too many pairs. At most " + std::to_string(MAX_BATCH_PAIRS) + " per batch.\n");
+                    break;
+                }
+                size_t count = static_cast<size_t>(requested);
+
+                auto xs = std::make_shared<std::vector<int>>();
+                auto ys = std::make_shared<std::vector<int>>();
+                xs->reserve(count);
+                ys->reserve(count);
+                bool valid = true;
+                while (xs->size() < count)
+                {
+                    std::string pairs = co_await session.recvLine();
+                    if (pairs.empty())
+                    {
+                        co_await session.hangUp();
+                        co_return;
+                    }
+                    std::istringstream pairs_iss(pairs);
+                    int xi, xj;
+                    while (xs->size() < count && pairs_iss >> xi >> xj)
+                    {
+                        xs->push_back(xi - 1);
+                        ys->push_back(xj - 1);
+                    }
+                    if (!pairs_iss.eof())
+                    {
+                        valid = false;
+                        break;
+                    }
+                }
+                if (!valid)
+                {
+                    co_await session.send("Invalid input. Pairs must be two integers each.\n");
+                    break;
+                }
+
+                // Not coalesced: the arguments are the whole batch
+                auto query = [xs, ys, graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto index = mstCache.getTreeIndex(*graph, mstType, mstRoot, token);
+                    if (!index)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    std::vector<long long> results(xs->size());
+                    index->distances(xs->data(), ys->data(), results.data(), results.size());
+
+                    std::string out = "Batch distances (" + std::to_string(results.size()) + " pairs):\n";
+                    out.reserve(out.size() + results.size() * 8);
+                    for (long long d : results) {
+                        out += d == TreeIndex::NO_PATH ? "unreachable" : std::to_string(d);
+                        out += '\n';
+                    }
+                    return out;
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, "", solve_cost(graph) + count, request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 12: // Bottleneck (minimax) edge between Xi and Xj
+            co_await session.send("Enter two vertices Xi and Xj:\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                std::istringstream iss(cmd);
+                int xi, xj;
+                if (!(iss >> xi >> xj))
+                {
+                    co_await session.send("Invalid input. Please enter two integers.\n");
+                    break;
+                }
+
+                std::string key = mst_key(mstType, mstRoot, "bottleneck " + std::to_string(xi) + " " + std::to_string(xj));
+                auto query = [xi, xj, graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
+                    if (!mstSolver)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    if (xi < 1 || xi > graph->getVertices() || xj < 1 || xj > graph->getVertices())
+                        return std::string("Invalid vertices.\n");
+                    long long bottleneck = mstSolver->getBottleneck(xi - 1, xj - 1);
+                    if (bottleneck == KruskalTree::NO_PATH)
+                        return "No path between " + std::to_string(xi) + " and " + std::to_string(xj) + " in MST.\n";
+                    return "Heaviest edge between " + std::to_string(xi) + " and " + std::to_string(xj) + " in MST: " + std::to_string(bottleneck) + "\n";
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, key, solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 13: // Euclidean MST of a point set, installed as the current graph
+            co_await session.send("Enter the number of points and the dimension (format: points dimension, dimension 2 or 3), then one point per line:\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                std::istringstream iss(cmd);
+                int points, dimension;
+                if (!(iss >> points >> dimension) || points < 1 || dimension < 2 || dimension > 3)
+                {
+                    co_await session.send("Invalid input. Please enter a positive number of points and a dimension of 2 or 3.\n");
+                    break;
+                }
+                // Checked before the coordinates are reserved
+                if (points > MAX_EUCLIDEAN_POINTS)
+                {
+                    co_await session.send("Too many points. At most " + std::to_string(MAX_EUCLIDEAN_POINTS) + " per upload.\n");
+                    break;
+                }
+
+                std::vector<double> coords;
+                coords.reserve(static_cast<size_t>(points) * dimension);
+                bool valid = true;
+                for (int i = 0; i < points && valid; ++i)
+                {
+                    std::string line = co_await session.recvLine();
+                    if (line.empty())
+                    {
+                        co_await session.hangUp();
+                        co_return;
+                    }
+                    std::istringstream point_iss(line);
+                    double x;
+                    for (int d = 0; d < dimension; ++d)
+                    {
+                        if (!(point_iss >> x) || !std::isfinite(x))
+                        {
+                            valid = false;
+                            break;
+                        }
+                        coords.push_back(x);
+                    }
+                }
+                if (!valid)
+                {
+                    co_await session.send("Invalid input. Each point needs " + std::to_string(dimension) + " coordinates.\n");
+                    break;
+                }
+
+                // Like case 10, the tree is built on the blocking pool and only installed through the active object
+                EuclideanMST euclidean(std::move(coords), dimension);
+                auto token = std::make_shared<CancellationToken>();
+                if (request_timeout.count() > 0)
+                    token->setDeadline(CancellationToken::Clock::now() + request_timeout);
+                euclidean.setCancellationToken(token);
+                bool timed_out = false;
+                try
+                {
+                    auto work = [&euclidean]()
+                    {
+                        euclidean.solve();
+                    };
+                    co_await run_blocking(reactor, threadPool, work, session.request);
+                }
+                catch (const OperationCancelled &)
+                {
+                    timed_out = true;
+                }
+                if (timed_out)
+                {
+                    co_await session.send("Request timed out.\n");
+                    break;
+                }
+
+                // Graph weights are integers, so distances are rounded; scale the coordinates for more precision
+                auto edges = std::make_shared<std::vector<std::tuple<int, int, double>>>(euclidean.getMSTEdges());
+                auto task = [graph, points, edges]()
+                {
+                    Graph::Batch batch(*graph);
+                    graph->newGraph(points, static_cast<int>(edges->size()));
+                    for (const auto &edge : *edges)
+                    {
+                        double w = std::min(std::round(std::get<2>(edge)), static_cast<double>(INT_MAX));
+                        graph->newEdge(std::get<0>(edge) + 1, std::get<1>(edge) + 1, static_cast<int>(w));
+                    }
+                    return std::string("Euclidean MST loaded as the current graph.\n");
+                };
+                co_await session.send(co_await run_on_ao(reactor, ao, task, session.request));
+                std::ostringstream summary;
+                summary << "Euclidean MST of " << points << " points: " << edges->size() << " edges, total length " << euclidean.getMSTWeight() << "\n";
+                co_await session.send(summary.str());
+            }
+            break;
+
+        case 14: // Sampled average distance and percentiles, with confidence intervals
+            co_await session.send("Enter the target relative error, the time budget in ms (0 = none) and optional percentiles (format: error budget [p ...], e.g. 0.01 500 50 90 99):\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                std::istringstream iss(cmd);
+                double relative_error;
+                long long budget_ms;
+                if (!(iss >> relative_error >> budget_ms) || relative_error <= 0 || budget_ms < 0)
+                {
+                    co_await session.send("Invalid input. Please enter a positive relative error and a non-negative budget.\n");
+                    break;
+                }
+                std::vector<double> levels;
+                double level;
+                while (iss >> level)
+                    levels.push_back(level);
+                if (!iss.eof() || std::any_of(levels.begin(), levels.end(), [](double p)
+                                              { return p < 0 || p > 100; }))
+                {
+                    co_await session.send("Invalid input. Percentiles must be numbers between 0 and 100.\n");
+                    break;
+                }
+
+                std::ostringstream args;
+                args << "sample " << relative_error << " " << budget_ms;
+                for (double p : levels)
+                    args << " " << p;
+                std::chrono::milliseconds budget(budget_ms);
+                auto query = [relative_error, budget, levels, graph, mstType, mstRoot, &mstCache, &computePool](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto index = mstCache.getTreeIndex(*graph, mstType, mstRoot, token);
+                    if (!index)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    DistanceSampler sampler(*index, computePool);
+                    sampler.setCancellationToken(token);
+                    DistanceEstimate estimate = sampler.estimate(relative_error, budget, levels);
+                    if (estimate.samples == 0)
+                        return std::string("No connected pairs in MST.\n");
+
+                    std::ostringstream out;
+                    out << "Approximate average distance in MST: " << estimate.mean.value << " (95% CI " << estimate.mean.low << " - " << estimate.mean.high
+                        << ", " << estimate.samples << " samples" << (estimate.converged ? "" : ", target error not reached") << ")\n";
+                    for (size_t i = 0; i < levels.size(); ++i)
+                        out << "p" << levels[i] << ": " << estimate.percentiles[i].value << " (95% CI " << estimate.percentiles[i].low << " - " << estimate.percentiles[i].high << ")\n";
+                    return out.str();
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, args.str()), solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 15: // Exact histogram and percentiles of all MST path lengths
+            co_await session.send("Enter the number of histogram buckets and optional percentiles (format: buckets [p ...], default percentiles 50 90 99):\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                std::istringstream iss(cmd);
+                int buckets;
+                if (!(iss >> buckets) || buckets < 1 || buckets > 1000)
+                {
+                    co_await session.send("Invalid input. Please enter between 1 and 1000 buckets.\n");
+                    break;
+                }
+                std::vector<double> levels;
+                double level;
+                while (iss >> level)
+                    levels.push_back(level);
+                if (!iss.eof() || std::any_of(levels.begin(), levels.end(), [](double p)
+                                              { return p < 0 || p > 100; }))
+                {
+                    co_await session.send("Invalid input. Percentiles must be numbers between 0 and 100.\n");
+                    break;
+                }
+                if (levels.empty())
+                    levels = {50, 90, 99};
+
+                std::ostringstream args;
+                args << "distribution " << buckets;
+                for (double p : levels)
+                    args << " " << p;
+                auto query = [buckets, levels, graph, mstType, mstRoot, &mstCache, &computePool](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
+                    if (!mstSolver)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    DistanceDistribution distribution(graph->getVertices(), mstSolver->getMSTEdges(), computePool);
+                    distribution.setCancellationToken(token);
+                    distribution.build();
+                    if (distribution.getPairCount() == 0)
+                        return std::string("No vertices in MST.\n");
+
+                    std::ostringstream out;
+                    out << "Distance distribution over " << distribution.getPairCount() << " pairs: average " << std::to_string(distribution.getAverageDistance())
+                        << ", longest " << distribution.getMaxDistance() << "\n";
+                    for (double p : levels)
+                        out << "p" << p << ": " << distribution.percentile(p) << "\n";
+                    std::vector<long long> counts = distribution.histogram(buckets);
+                    long long low = distribution.getMinDistance();
+                    for (int b = 0; b < buckets; ++b) {
+                        long long high = distribution.bucketEdge(b, buckets);
+                        out << (b == 0 ? "[" : "(") << low << ", " << high << "]: " << counts[b] << "\n";
+                        low = high;
+                    }
+                    return out.str();
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, args.str()), all_pairs_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 16: // Retained graph versions
+            {
+                auto task = [graph]()
+                {
+                    std::ostringstream out;
+                    auto versions = graph->getHistory();
+                    out << "Retained versions (current: " << graph->getVersion() << "):\n";
+                    for (const auto& info : versions) {
+                        out << "Version " << info.version;
+                        if (info.parent != GraphHistory::NONE)
+                            out << " <- " << info.parent << ", " << info.changes << " changes";
+                        if (info.version == graph->getVersion())
+                            out << " (current)";
+                        out << "\n";
+                    }
+                    return out.str();
+                };
+                co_await session.send(co_await run_on_ao(reactor, ao, task, session.request));
+            }
+            break;
+
+        case 17: // Move the shared graph to a retained version
+            co_await session.send("Enter the version to roll back to:\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                std::istringstream iss(cmd);
+                uint64_t target;
+                if (!(iss >> target))
+                {
+                    co_await session.send("Invalid input. Please enter a version number.\n");
+                    break;
+                }
+
+                auto task = [target, graph, mstType, mstRoot, &mstCache]()
+                {
+                    if (!graph->checkout(target))
+                        return "Version " + std::to_string(target) + " is not retained.\n";
+                    // Usually a cache hit: the MST of a recent version is kept
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, nullptr);
+                    if (mstSolver) {
+                        return "Rolled back to version " + std::to_string(target) + " and MST updated successfully.\n";
+                    }
+                    return std::string("Failed to update MST.\n");
+                };
+                co_await session.send(co_await run_on_ao(reactor, ao, task, session.request));
+            }
+            break;
+
+        case 18: // MST of a retained version, leaving the current graph alone
+            co_await session.send("Enter the version:\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                std::istringstream iss(cmd);
+                uint64_t target;
+                if (!(iss >> target))
+                {
+                    co_await session.send("Invalid input. Please enter a version number.\n");
+                    break;
+                }
+
+                auto query = [target, graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    if (!graph->hasVersion(target))
+                        return "Version " + std::to_string(target) + " is not retained.\n";
+                    auto mstSolver = mstCache.getSolverAt(*graph, target, mstType, mstRoot, token);
+                    if (!mstSolver)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    return "Total weight of MST at version " + std::to_string(target) + ": " + std::to_string(mstSolver->getMSTWeight()) +
+                           " (" + std::to_string(mstSolver->getMSTEdges().size()) + " edges)\n";
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "version " + std::to_string(target)), solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 19: // Sensitivity range of one edge's weight
+            if (mstType == MSTType::EDMONDS)
+            {
+                co_await session.send("Edge tolerance is only available for Kruskal and Prim.\n");
+                break;
+            }
+            co_await session.send("Enter the edge (format: u v):\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            {
+                std::istringstream iss(cmd);
+                int u, v_edge;
+                if (!(iss >> u >> v_edge))
+                {
+                    co_await session.send("Invalid input. Please enter two integers.\n");
+                    break;
+                }
+
+                std::string key = mst_key(mstType, mstRoot, "tolerance " + std::to_string(u) + " " + std::to_string(v_edge));
+                auto query = [u, v_edge, graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    if (u < 1 || u > graph->getVertices() || v_edge < 1 || v_edge > graph->getVertices())
+                        return std::string("Invalid vertices.\n");
+                    auto sensitivity = mstCache.getSensitivity(*graph, mstType, mstRoot, token);
+                    if (!sensitivity)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    MSTSensitivity::Tolerance tolerance;
+                    std::string edge = "(" + std::to_string(u) + ", " + std::to_string(v_edge) + ")";
+                    if (!sensitivity->lookup(u - 1, v_edge - 1, tolerance))
+                        return "No edge " + edge + " in the graph.\n";
+                    std::string current = "Edge " + edge + " with weight " + std::to_string(tolerance.weight);
+                    if (tolerance.inTree) {
+                        if (tolerance.limit == MSTSensitivity::UNBOUNDED)
+                            return current + " is in the MST and stays at any weight (no other edge crosses its cut).\n";
+                        return current + " is in the MST and stays while its weight is at most " + std::to_string(tolerance.limit) +
+                               " (lightest replacement edge).\n";
+                    }
+                    if (tolerance.limit == MSTSensitivity::NEVER)
+                        return current + " is a self-loop and never joins the MST.\n";
+                    return current + " is not in the MST and stays out while its weight is at least " + std::to_string(tolerance.limit) +
+                           " (heaviest MST edge on its cycle).\n";
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, key, solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 20: // Every MST edge; local clients get a memfd instead of text
+            if (session.local)
+            {
+                auto fd = std::make_shared<int>(-1);
+                auto task = [graph, mstType, mstRoot, &mstCache, fd]()
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, nullptr);
+                    if (!mstSolver)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    const auto &mst = mstSolver->getMSTEdges();
+                    auto fill = [&mst](SharedEdges::Edge *out)
+                    {
+                        for (size_t i = 0; i < mst.size(); ++i)
+                            out[i] = {std::get<0>(mst[i]) + 1, std::get<1>(mst[i]) + 1, std::get<2>(mst[i])};
+                    };
+                    try
+                    {
+                        *fd = SharedEdges::create(mst.size(), fill);
+                    }
+                    catch (const std::exception &ex)
+                    {
+                        return "Cannot share the MST edges: " + std::string(ex.what()) + "\n";
+                    }
+                    return "MST edges: " + std::to_string(mst.size()) + " (memfd attached)\n";
+                };
+                response = co_await run_on_ao(reactor, ao, task, session.request);
+                if (*fd < 0)
+                {
+                    co_await session.send(response);
+                    break;
+                }
+                co_await session.sendFd(response, *fd);
+                close(*fd);
+                break;
+            }
+            {
+                auto query = [graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto mstSolver = mstCache.getSolver(*graph, mstType, mstRoot, token);
+                    if (!mstSolver)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    const auto &mst = mstSolver->getMSTEdges();
+                    std::ostringstream out;
+                    out << "MST edges: " << mst.size() << "\n";
+                    for (const auto &edge : mst)
+                        out << std::get<0>(edge) + 1 << " " << std::get<1>(edge) + 1 << " " << std::get<2>(edge) << "\n";
+                    return out.str();
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "edges"), solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 21: // Weight, diameter and average distance from one tree index
+            {
+                auto query = [graph, mstType, mstRoot, &mstCache](std::shared_ptr<const CancellationToken> token)
+                {
+                    auto index = mstCache.getTreeIndex(*graph, mstType, mstRoot, token);
+                    if (!index)
+                        return std::string("MST algorithm not set or invalid.\n");
+                    return "Total weight of MST: " + std::to_string(index->getTotalWeight()) + "\n"
+                           "Longest distance in MST: " + std::to_string(index->getDiameter()) + "\n"
+                           "Average distance in MST: " + std::to_string(index->getAverageDistance()) + "\n";
+                };
+                if (!co_await run_coalesced(session, ao, flights, graph, mst_key(mstType, mstRoot, "metrics"), solve_cost(graph), request_timeout, query, response))
+                {
+                    co_await session.hangUp();
+                    co_return;
+                }
+                co_await session.send(response);
+            }
+            break;
+
+        case 22: // Span tracing, switched for the whole server
+            co_await session.send("Enter 'on', 'off' or 'dump':\n");
+            cmd = co_await session.recvLine();
+            if (cmd.empty())
+            {
+                co_await session.hangUp();
+                co_return;
+            }
+
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+            if (cmd == "on" || cmd == "off")
+            {
+                Trace::setEnabled(cmd == "on");
+                if (cmd == "on")
+                    co_await session.send("Tracing enabled.\n");
+                else
+                    co_await session.send("Tracing disabled.\n");
+            }
+            else if (cmd == "dump")
+            {
+                long long spans = -1;
+                auto work = [&spans]()
+                {
+                    spans = dump_trace();
+                };
+                co_await run_blocking(reactor, threadPool, work, session.request);
+                if (spans < 0)
+                    response = "Failed to write " TRACE_PATH ".\n";
+                else
+                    response = "Trace of " + std::to_string(spans) + " spans written to " TRACE_PATH ".\n";
+                co_await session.send(response);
+            }
+            else
+            {
+                co_await session.send("Invalid input. Please enter 'on', 'off' or 'dump'.\n");
+            }
+            break;
+
+        default:
+            co_await session.send("Invalid operation selected.\n");
+            break;
+        }
+    }
+}
+
+// One reactor thread pinned to a core, with its own SO_REUSEPORT listener on PORT. The kernel
+// spreads new connections over the listeners and each connection stays on the reactor that accepted it.
+struct ReactorShard
+{
+    Reactor reactor;
+    int listener = -1;
+    std::set<int> sessions; // Open client sockets, touched on this reactor only
+    bool closing = false;   // Set on the reactor when the server shuts down
+    std::unordered_map<int, std::function<void()>> wakeAccept; // Per listener: ends the wait of accept_clients early
+    std::thread thread;
+};
+
+// Runs a session and forgets its socket once the session has closed it. A session that throws
+// leaves its socket open, so it is closed here instead of lingering in CLOSE_WAIT.
+Task<void> serve_client(ReactorShard &shard, int client_sock, bool local, ActiveObject &ao, SingleFlight &flights, ThreadPool &threadPool,
+                        ThreadPool &computePool, MSTCache &mstCache)
+{
+    bool failed = false;
+    std::string failure = "unknown error";
+    try
+    {
+        co_await handle_client(shard.reactor, client_sock, local, ao, flights, threadPool, computePool, mstCache);
+    }
+    catch (const std::exception &e)
+    {
+        failed = true;
+        failure = e.what();
+    }
+    catch (...)
+    {
+        failed = true;
+    }
+    if (failed)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cout_mutex);
+            std::cerr << "Session ended by an error: " << failure << std::endl;
+        }
+        close(client_sock);
+    }
+    shard.sessions.erase(client_sock);
+}
+
+// Accepts connections on listener and starts their sessions on the shard's reactor, until the
+// shard is closing. local marks the Unix-domain listener.
+Task<void> accept_clients(ReactorShard &shard, int listener, bool local, ActiveObject &ao, SingleFlight &flights, ThreadPool &threadPool,
+                          ThreadPool &computePool, MSTCache &mstCache)
+{
+    while (!shard.closing)
+    {
+        Reactor::Wait readable(shard.reactor, listener, EPOLLIN, Reactor::Clock::time_point::max(), [&shard, listener](std::function<void()> wake)
+                               { shard.wakeAccept[listener] = wake; });
+        co_await readable;
+        shard.wakeAccept.erase(listener);
+
+        while (!shard.closing)
+        {
+            struct sockaddr_storage client_addr;
+            socklen_t addr_size = sizeof(client_addr);
+            int client_fd = accept4(listener, (struct sockaddr *)&client_addr, &addr_size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (client_fd < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED)
+                    perror("Accept error");
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(cout_mutex);
+                if (local)
+                    std::cout << "Accepted local connection" << std::endl;
+                else
+                    std::cout << "Accepted connection from " << inet_ntoa(((struct sockaddr_in *)&client_addr)->sin_addr) << std::endl;
+            }
+            shard.sessions.insert(client_fd);
+            shard.reactor.spawn(serve_client(shard, client_fd, local, ao, flights, threadPool, computePool, mstCache));
+        }
+    }
+    close(listener);
+}
+
+// Non-blocking listener on PORT that shares the port with the other shards; -1 on error
+int open_listener()
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("Socket error");
+        return -1;
+    }
+
+    // Set socket options to reuse address and port
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+    // Bind
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(PORT);
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    if (bind(listener_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    if (bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
     {
         perror("Bind error");
-        close(listener_fd);
-        exit(1);
+        close(fd);
+        return -1;
     }
 
     // Listen
-    if (listen(listener_fd, 10) < 0)
+    if (listen(fd, LISTEN_BACKLOG) < 0)
     {
         perror("Listen error");
-        close(listener_fd);
-        exit(1);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Non-blocking listener on UNIX_SOCKET_PATH for clients on this host; -1 on error
+int open_unix_listener()
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("Unix socket error");
+        return -1;
+    }
+
+    // A socket file left behind by an earlier run would make bind fail
+    unlink(UNIX_SOCKET_PATH);
+    struct sockaddr_un server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sun_family = AF_UNIX;
+    strncpy(server_addr.sun_path, UNIX_SOCKET_PATH, sizeof(server_addr.sun_path) - 1);
+    if (bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 || listen(fd, LISTEN_BACKLOG) < 0)
+    {
+        perror("Unix socket bind error");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Creates the data directory if needed, then insists it is a real directory (not a symlink)
+// owned by this user with mode 0700, so no other user can plant, swap or read files in it
+bool prepare_data_dir(std::string path, std::string &canonical)
+{
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+    if (mkdir(path.c_str(), 0700) == 0)
+    {
+        chmod(path.c_str(), 0700); // mkdir applies the umask
+    }
+    else if (errno != EEXIST)
+    {
+        std::cerr << "Cannot create data directory " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != geteuid() || (info.st_mode & 07777) != 0700)
+    {
+        std::cerr << "Data directory " << path << " must be a directory owned by this user with mode 0700" << std::endl;
+        return false;
+    }
+    char resolved[PATH_MAX];
+    if (!realpath(path.c_str(), resolved))
+    {
+        std::cerr << "Data directory " << path << " is unavailable: " << strerror(errno) << std::endl;
+        return false;
+    }
+    canonical = resolved;
+    return true;
+}
+
+int main()
+{
+    // SIGTERM and SIGINT are taken by sigwait() below; blocking them before any thread
+    // starts keeps them from interrupting the reactors. SIGUSR1 dumps the trace.
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGTERM);
+    sigaddset(&stop_signals, SIGINT); // Handle Ctrl+C gracefully
+    sigaddset(&stop_signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    // MST_TRACE=1 starts with span tracing on; it can be switched later with option 22
+    const char *trace_env = getenv("MST_TRACE");
+    if (trace_env && strcmp(trace_env, "0") != 0)
+        Trace::setEnabled(true);
+
+    // Option 10 only touches files under the data directory
+    const char *data_env = getenv("MST_DATA_DIR");
+    if (!prepare_data_dir(data_env && *data_env ? data_env : DATA_DIR, data_dir))
+        return 1;
+
+    // One listener and reactor per core this process may use, each pinned to the next allowed CPU
+    unsigned cores = static_cast<unsigned>(ThreadPool::availableCpus());
+    std::vector<int> allowed_cpus = ThreadPool::allowedCpus();
+    std::vector<std::unique_ptr<ReactorShard>> shards;
+    for (unsigned i = 0; i < cores; ++i)
+    {
+        auto shard = std::make_unique<ReactorShard>();
+        shard->listener = open_listener();
+        if (shard->listener < 0)
+        {
+            for (auto &opened : shards)
+                close(opened->listener);
+            exit(1);
+        }
+        shards.push_back(std::move(shard));
     }
 
     std::cout << "Server is listening on port " << PORT << std::endl;
 
-    // ThreadPool and ActiveObject
-    ThreadPool threadPool(4);
+    // Optional: without it the server still serves TCP
+    int unix_listener = open_unix_listener();
+    if (unix_listener >= 0)
+        std::cout << "Server is listening on " << UNIX_SOCKET_PATH << std::endl;
+
+    // Sessions are coroutines on the reactors; the thread pool only runs blocking work
+    ThreadPool::Options blocking;
+    blocking.maxThreads = BLOCKING_POOL_THREADS;
+    blocking.idleTimeout = std::chrono::milliseconds(POOL_IDLE_MS);
+    ThreadPool threadPool(blocking, "blocking pool");
+    // Separate pool for parallel solver work, so it never waits behind blocking loads. It grows
+    // to one worker per available CPU (MST_COMPUTE_THREADS overrides), spread over NUMA nodes.
+    ThreadPool::Options compute;
+    const char *compute_env = getenv("MST_COMPUTE_THREADS");
+    compute.maxThreads = compute_env ? strtoul(compute_env, nullptr, 10) : 0;
+    compute.idleTimeout = std::chrono::milliseconds(POOL_IDLE_MS);
+    compute.affinity = ThreadPool::Affinity::NUMA_NODE;
+    ThreadPool computePool(compute, "compute pool");
     ActiveObject ao;
+    SingleFlight flights(64);
+    MSTCache mstCache;
+    mstCache.setThreadPool(&computePool);
+    Graph::getInstance()->setHistoryCapacity(GRAPH_HISTORY_VERSIONS, GRAPH_HISTORY_BYTES);
+    Graph::getInstance()->setCompactThreshold(COMPACT_GRAPH_EDGES);
 
-    while (true)
+    for (unsigned i = 0; i < cores; ++i)
     {
-        addr_size = sizeof(client_addr);
-        client_fd = accept(listener_fd, (struct sockaddr *)&client_addr, &addr_size);
-        if (client_fd < 0)
-        {
-            if (listener_fd == -1)
-            {
-                // Listener socket was closed by signal handler, exit the loop
-                break;
-            }
-            perror("Accept error");
+        ReactorShard &shard = *shards[i];
+        shard.reactor.spawn(accept_clients(shard, shard.listener, false, ao, flights, threadPool, computePool, mstCache));
+        if (i == 0 && unix_listener >= 0)
+            shard.reactor.spawn(accept_clients(shard, unix_listener, true, ao, flights, threadPool, computePool, mstCache));
+        shard.thread = std::thread([&shard, i]()
+                                   {
+                                       Trace::setThreadName("reactor " + std::to_string(i));
+                                       shard.reactor.run(); });
+        if (allowed_cpus.empty())
             continue;
-        }
+        int cpu = allowed_cpus[i % allowed_cpus.size()];
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        int error = pthread_setaffinity_np(shard.thread.native_handle(), sizeof(cpus), &cpus);
+        if (error != 0)
         {
             std::lock_guard<std::mutex> lock(cout_mutex);
-            std::cout << "Accepted connection from " << inet_ntoa(client_addr.sin_addr) << std::endl;
+            std::cerr << "Could not pin reactor " << i << " to CPU " << cpu << ": " << strerror(error) << std::endl;
         }
-        threadPool.enqueue([client_fd, &ao]()
-                           { handle_client(client_fd, ao); });
+    }
+
+    int received = 0;
+    while (sigwait(&stop_signals, &received) == 0 && received == SIGUSR1)
+    {
+        long long spans = dump_trace();
+        std::lock_guard<std::mutex> lock(cout_mutex);
+        if (spans < 0)
+            std::cout << "Failed to write " << TRACE_PATH << std::endl;
+        else
+            std::cout << "Trace of " << spans << " spans written to " << TRACE_PATH << std::endl;
     }
 
     // Server is shutting down
@@ -444,8 +1957,26 @@ int main()
         std::lock_guard<std::mutex> lock(cout_mutex);
         std::cout << "Server is shutting down..." << std::endl;
     }
+    // Closing the listeners and hanging up every socket makes each task finish on its own
+    for (auto &shard : shards)
+    {
+        ReactorShard *owned = shard.get();
+        owned->reactor.post([owned]()
+                            {
+                                owned->closing = true;
+                                for (auto &waiting : owned->wakeAccept)
+                                    waiting.second();
+                                for (int fd : owned->sessions)
+                                    shutdown(fd, SHUT_RDWR); });
+        owned->reactor.stopWhenIdle();
+    }
+    for (auto &shard : shards)
+        shard->thread.join();
+    if (unix_listener >= 0)
+        unlink(UNIX_SOCKET_PATH);
     threadPool.stop();
     ao.stop();
+    computePool.stop();
     Graph::destroyInstance();
     return 0;
 }
@@ -0,0 +1,62 @@
+#include "SharedEdges.h"
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SharedEdges::SharedEdges(int fd) : edges(nullptr), count(0), length(0) {
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK))
+        throw std::runtime_error("edge buffer must be a memfd sealed with F_SEAL_SHRINK");
+
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+        throw std::runtime_error(std::string("cannot stat edge buffer: ") + strerror(errno));
+    if (info.st_size % sizeof(Edge) != 0)
+        throw std::runtime_error("edge buffer size is not a whole number of edges");
+
+    length = static_cast<size_t>(info.st_size);
+    count = length / sizeof(Edge);
+    if (length == 0)
+        return;
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error(std::string("cannot map edge buffer: ") + strerror(errno));
+    edges = static_cast<const Edge*>(mapped);
+}
+
+SharedEdges::~SharedEdges() {
+    if (edges)
+        munmap(const_cast<Edge*>(edges), length);
+}
+
+int SharedEdges::create(size_t count, const std::function<void(Edge*)>& fill) {
+    int fd = memfd_create("mst-edges", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+        throw std::runtime_error(std::string("memfd_create failed: ") + strerror(errno));
+
+    size_t bytes = count * sizeof(Edge);
+    if (ftruncate(fd, static_cast<off_t>(bytes)) < 0) {
+        int err = errno;
+        close(fd);
+        throw std::runtime_error(std::string("cannot size edge buffer: ") + strerror(err));
+    }
+    if (bytes > 0) {
+        void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error(std::string("cannot map edge buffer: ") + strerror(err));
+        }
+        fill(static_cast<Edge*>(mapped));
+        munmap(mapped, bytes);
+    }
+
+    // The receiver maps it without copying, so it must not change under them
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    return fd;
+}
@@ -0,0 +1,43 @@
+#ifndef SHARED_EDGES_H
+#define SHARED_EDGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Edge array exchanged with a co-located client through a memfd passed over the
+// Unix-domain socket (SCM_RIGHTS). Both processes map the same pages, so bulk
+// uploads and MST dumps never travel through the socket. The layout is packed
+// native-endian int32 triples (u, v, weight) with 1-based vertices, as in the
+// text protocol.
+class SharedEdges {
+public:
+    struct Edge {
+        int32_t u;
+        int32_t v;
+        int32_t w;
+    };
+
+    // Maps fd read-only; fd stays owned by the caller. The sender must have sealed
+    // it against shrinking, so the pages cannot vanish while they are mapped.
+    // Throws std::runtime_error.
+    explicit SharedEdges(int fd);
+    ~SharedEdges();
+
+    SharedEdges(const SharedEdges&) = delete;
+    SharedEdges& operator=(const SharedEdges&) = delete;
+
+    size_t size() const { return count; }
+    const Edge& operator[](size_t i) const { return edges[i]; }
+
+    // New memfd of count edges written by fill, sealed against any later change.
+    // The caller owns the returned fd. Throws std::runtime_error.
+    static int create(size_t count, const std::function<void(Edge*)>& fill);
+
+private:
+    const Edge* edges;
+    size_t count;
+    size_t length; // Mapped bytes
+};
+
+#endif // SHARED_EDGES_H
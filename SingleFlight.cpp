@@ -0,0 +1,115 @@
+#include "SingleFlight.h"
+#include <algorithm>
+
+bool SingleFlight::Flight::join(CancellationToken::Clock::time_point deadline) {
+    std::lock_guard<std::mutex> lock(mtx);
+    // Checked under the lock leave() cancels under, so the last waiter cannot cancel it in between
+    if (!usable())
+        return false;
+    // The computation lives as long as its most patient waiter
+    if (waiters == 0 || deadline > token->getDeadline())
+        token->setDeadline(deadline);
+    waiters++;
+    return true;
+}
+
+void SingleFlight::Flight::leave() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (--waiters == 0 && result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        token->cancel();
+}
+
+bool SingleFlight::Flight::usable() const {
+    if (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return !token->isCancelled();
+    try {
+        result.get();
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+void SingleFlight::Flight::complete(std::string value) {
+    promise.set_value(std::move(value));
+    publish();
+}
+
+void SingleFlight::Flight::fail(std::exception_ptr error) {
+    promise.set_exception(error);
+    publish();
+}
+
+void SingleFlight::Flight::publish() {
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ready = true;
+        callbacks.swap(watchers);
+    }
+    for (auto& callback : callbacks)
+        callback();
+}
+
+void SingleFlight::Flight::onReady(std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!ready) {
+            watchers.push_back(std::move(callback));
+            return;
+        }
+    }
+    callback();
+}
+
+SingleFlight::SingleFlight(size_t capacity) : capacity(capacity), version(0) {}
+
+std::shared_ptr<SingleFlight::Flight> SingleFlight::run(uint64_t graphVersion, const std::string& key,
+                                                        CancellationToken::Clock::time_point deadline, const Launcher& launch) {
+    auto flight = std::make_shared<Flight>();
+    flight->result = flight->promise.get_future().share();
+    flight->token = std::make_shared<CancellationToken>();
+    flight->version = graphVersion;
+    flight->key = key;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (graphVersion != version) {
+            // Every cached result belongs to another graph version (rollbacks move it backwards too)
+            flights.clear();
+            order.clear();
+            version = graphVersion;
+        }
+        if (!key.empty()) {
+            auto it = flights.find(key);
+            // A cancelled flight either failed or is about to; start a fresh one
+            if (it != flights.end() && it->second->join(deadline))
+                return it->second;
+            if (it != flights.end()) {
+                it->second = flight;
+            } else {
+                if (flights.size() >= capacity && !order.empty()) {
+                    flights.erase(order.front());
+                    order.pop_front();
+                }
+                flights.emplace(key, flight);
+                order.push_back(key);
+            }
+        }
+        // Requests without a key are computed but never cached
+        flight->join(deadline);
+    }
+    launch(flight);
+    return flight;
+}
+
+void SingleFlight::computedOn(const std::shared_ptr<Flight>& flight, uint64_t graphVersion) {
+    if (graphVersion == flight->version || flight->key.empty())
+        return;
+    std::lock_guard<std::mutex> lock(mtx);
+    // Gone already if the cache has moved to another version or replaced the flight
+    auto it = flights.find(flight->key);
+    if (it == flights.end() || it->second != flight)
+        return;
+    flights.erase(it);
+    order.erase(std::find(order.begin(), order.end(), flight->key));
+}
@@ -0,0 +1,79 @@
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <string>
+#include <future>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "CancellationToken.h"
+
+// Coalesces identical requests against the same graph version: the first caller
+// launches the computation, concurrent duplicates share its future and later
+// ones are served from a small cache until the graph version changes.
+class SingleFlight {
+public:
+    // One shared computation. Its token fires once every waiter has abandoned it,
+    // or when the latest deadline among its waiters has passed.
+    class Flight {
+    public:
+        std::shared_future<std::string> result;
+        std::shared_ptr<CancellationToken> token;
+
+        // Called by every waiter once it stops waiting, with or without the result;
+        // the last one to leave an unfinished flight cancels it
+        void leave();
+        // False once the flight was cancelled or failed; a finished result stays usable
+        bool usable() const;
+
+        // Called by the computation to publish its outcome; wakes every onReady callback
+        void complete(std::string value);
+        void fail(std::exception_ptr error);
+        // Runs callback (on the completing thread) once the result is ready, or right away if it is
+        void onReady(std::function<void()> callback);
+
+    private:
+        friend class SingleFlight;
+        // Adds a waiter, or returns false if the flight is no longer usable
+        bool join(CancellationToken::Clock::time_point deadline);
+        void publish();
+
+        mutable std::mutex mtx;
+        uint64_t version = 0; // Graph version the flight is cached under
+        std::string key;
+        int waiters = 0;
+        std::promise<std::string> promise;
+        bool ready = false;
+        std::vector<std::function<void()>> watchers;
+    };
+
+    using Launcher = std::function<void(std::shared_ptr<Flight>)>;
+
+    explicit SingleFlight(size_t capacity);
+
+    // Joins the flight for key as a new waiter; launch is invoked only when no cached,
+    // live in-flight result exists and must complete or fail the flight, even once its
+    // token is cancelled (fail it with OperationCancelled then).
+    // An empty key opts out of coalescing but keeps the waiter/cancellation handling.
+    std::shared_ptr<Flight> run(uint64_t graphVersion, const std::string& key,
+                                CancellationToken::Clock::time_point deadline, const Launcher& launch);
+
+    // Called by the computation with the graph version it actually reads. If a mutation overtook
+    // the request since run(), the flight is dropped from the cache: its result still reaches the
+    // waiters already joined, but is never served under the version it was keyed by.
+    void computedOn(const std::shared_ptr<Flight>& flight, uint64_t graphVersion);
+
+private:
+    size_t capacity;
+    uint64_t version;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+    std::deque<std::string> order; // Insertion order, oldest first, for eviction
+    std::mutex mtx;
+};
+
+#endif // SINGLE_FLIGHT_H
@@ -0,0 +1,129 @@
+#include "SpanningForest.h"
+#include "ConcurrentUnionFind.h"
+#include <exception>
+
+namespace {
+
+// Edges handled by one labelling task
+const size_t LABEL_GRAIN = 1 << 16;
+
+// Waits for every task, then rethrows the first failure
+template <typename T>
+std::vector<T> collect(std::vector<std::future<T>>& tasks) {
+    std::vector<T> results;
+    std::exception_ptr failure;
+    for (auto& task : tasks) {
+        try {
+            results.push_back(task.get());
+        } catch (...) {
+            if (!failure)
+                failure = std::current_exception();
+        }
+    }
+    if (failure)
+        std::rethrow_exception(failure);
+    return results;
+}
+
+}
+
+SpanningForest::SpanningForest(const Graph& graph, MSTType type, ThreadPool& pool)
+    : graph(graph), type(type), pool(pool) {}
+
+void SpanningForest::setCancellationToken(std::shared_ptr<const CancellationToken> token) {
+    cancelToken = std::move(token);
+}
+
+int SpanningForest::labelComponents() {
+    int V = graph.getVertices();
+    const auto& edges = graph.getEdges();
+    ConcurrentUnionFind sets(V);
+
+    std::vector<std::future<bool>> tasks;
+    for (size_t begin = 0; begin < edges.size(); begin += LABEL_GRAIN) {
+        size_t end = std::min(edges.size(), begin + LABEL_GRAIN);
+        tasks.push_back(pool.submit([&edges, &sets, begin, end]() {
+            for (size_t i = begin; i < end; ++i)
+                sets.unite(std::get<0>(edges[i]), std::get<1>(edges[i]));
+            return true;
+        }));
+    }
+    collect(tasks);
+
+    // Roots are the smallest member, so a single scan numbers components in vertex order
+    labels.assign(V, -1);
+    int count = 0;
+    for (int v = 0; v < V; ++v) {
+        int root = sets.find(v);
+        labels[v] = root == v ? count++ : labels[root];
+    }
+    return count;
+}
+
+void SpanningForest::solve() {
+    components.clear();
+    int count = labelComponents();
+    if (cancelToken)
+        cancelToken->throwIfCancelled();
+
+    // Renumber vertices inside their component and split the edge list
+    int V = graph.getVertices();
+    std::vector<int> local(V);
+    std::vector<int> sizes(count, 0);
+    for (int v = 0; v < V; ++v)
+        local[v] = sizes[labels[v]]++;
+
+    std::vector<std::vector<std::tuple<int, int, int>>> componentEdges(count);
+    for (const auto& edge : graph.getEdges()) {
+        int u = std::get<0>(edge);
+        int v = std::get<1>(edge);
+        componentEdges[labels[u]].emplace_back(local[u], local[v], std::get<2>(edge));
+    }
+
+    components.assign(count, ComponentSummary{1, 0, 0, 0.0});
+    std::vector<int> solved;
+    std::vector<std::future<ComponentSummary>> tasks;
+    for (int c = 0; c < count; ++c) {
+        if (sizes[c] == 1)
+            continue;
+        solved.push_back(c);
+        auto edges = std::make_shared<std::vector<std::tuple<int, int, int>>>(std::move(componentEdges[c]));
+        int size = sizes[c];
+        MSTType solverType = type;
+        bool directed = graph.isDirected();
+        auto token = cancelToken;
+        tasks.push_back(pool.submit([edges, size, solverType, directed, token]() {
+            // Same directedness as the whole graph, so antiparallel edges stay distinct and the
+            // solver applies its own semantics to them, exactly as it does on the whole graph
+            Graph component;
+            component.newGraph(size, static_cast<int>(edges->size()), directed);
+            for (const auto& edge : *edges)
+                component.newEdge(std::get<0>(edge) + 1, std::get<1>(edge) + 1, std::get<2>(edge));
+            edges->clear();
+
+            auto solver = MSTFactory::createMST(solverType, component);
+            solver->setCancellationToken(token);
+            solver->solve();
+            return ComponentSummary{size, solver->getMSTWeight(), solver->getDiameter(), solver->getAverageDistance()};
+        }));
+    }
+
+    std::vector<ComponentSummary> results = collect(tasks);
+    for (size_t i = 0; i < solved.size(); ++i)
+        components[solved[i]] = results[i];
+}
+
+long long SpanningForest::getTotalWeight() const {
+    long long total = 0;
+    for (const auto& component : components)
+        total += component.weight;
+    return total;
+}
+
+const std::vector<ComponentSummary>& SpanningForest::getComponents() const {
+    return components;
+}
+
+const std::vector<int>& SpanningForest::getLabels() const {
+    return labels;
+}
@@ -0,0 +1,49 @@
+#ifndef SPANNING_FOREST_H
+#define SPANNING_FOREST_H
+
+#include "Graph.h"
+#include "MSTFactory.h"
+#include "ThreadPool.h"
+#include "CancellationToken.h"
+#include <vector>
+#include <memory>
+
+// Metrics of one tree of the spanning forest
+struct ComponentSummary {
+    int vertices;
+    long long weight;
+    long long diameter;
+    double averageDistance;
+};
+
+// Minimum spanning forest of a possibly disconnected graph. Components are
+// labelled once with a concurrent union-find, then each one is copied into its
+// own Graph and solved as an independent task on the pool.
+class SpanningForest {
+public:
+    // Like MSTFactory, PRIM requires an undirected graph
+    SpanningForest(const Graph& graph, MSTType type, ThreadPool& pool);
+
+    void setCancellationToken(std::shared_ptr<const CancellationToken> token);
+
+    void solve();
+
+    long long getTotalWeight() const;
+    // One entry per component, in the order of their smallest vertex
+    const std::vector<ComponentSummary>& getComponents() const;
+    // Component index of every vertex
+    const std::vector<int>& getLabels() const;
+
+private:
+    // Returns the number of components
+    int labelComponents();
+
+    const Graph& graph;
+    MSTType type;
+    ThreadPool& pool;
+    std::shared_ptr<const CancellationToken> cancelToken;
+    std::vector<int> labels;
+    std::vector<ComponentSummary> components;
+};
+
+#endif // SPANNING_FOREST_H
@@ -1,53 +1,281 @@
 #include "ThreadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <sstream>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
 
-ThreadPool::ThreadPool(size_t numThreads) : stop_flag(false) {
-    for (size_t i = 0; i < numThreads; ++i) {
-        workers.emplace_back(&ThreadPool::worker_thread, this);
+namespace {
+
+// Parses a kernel CPU list such as "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        } catch (const std::exception&) {
+            // Blank or malformed entry
+        }
     }
+    return cpus;
+}
+
+// CPUs allowed to us on each NUMA node that has any; empty without NUMA information
+std::vector<std::vector<int>> numaNodes(const std::vector<int>& allowed) {
+    std::vector<std::pair<int, std::vector<int>>> nodes;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (!dir)
+        return {};
+    while (struct dirent* entry = readdir(dir)) {
+        std::string dirName = entry->d_name;
+        if (dirName.compare(0, 4, "node") != 0 || dirName.size() == 4 || !isdigit(static_cast<unsigned char>(dirName[4])))
+            continue;
+        std::ifstream file("/sys/devices/system/node/" + dirName + "/cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(list))
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+                cpus.push_back(cpu);
+        if (!cpus.empty())
+            nodes.emplace_back(std::stoi(dirName.substr(4)), std::move(cpus));
+    }
+    closedir(dir);
+
+    std::sort(nodes.begin(), nodes.end());
+    std::vector<std::vector<int>> result;
+    for (auto& node : nodes)
+        result.push_back(std::move(node.second));
+    return result;
+}
+
+// CPU quota of our cgroup as a whole number of CPUs (rounded up), or 0 if unlimited or unknown
+size_t cgroupCpuLimit() {
+    // v2: "quota period" or "max period" in cpu.max of the cgroup listed as "0::<path>"
+    std::ifstream self("/proc/self/cgroup");
+    std::string line, path;
+    while (std::getline(self, line))
+        if (line.compare(0, 3, "0::") == 0)
+            path = line.substr(3);
+    for (const std::string& dir : {"/sys/fs/cgroup" + path, std::string("/sys/fs/cgroup")}) {
+        std::ifstream max(dir + "/cpu.max");
+        std::string quota;
+        long long period = 0;
+        if (max >> quota >> period) {
+            if (quota == "max" || period <= 0)
+                return 0;
+            long long q = std::atoll(quota.c_str());
+            return q > 0 ? static_cast<size_t>((q + period - 1) / period) : 0;
+        }
+    }
+
+    // v1: cfs_quota_us is -1 when unlimited
+    std::ifstream quotaFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+    std::ifstream periodFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+    long long quota = 0, period = 0;
+    if (quotaFile >> quota && periodFile >> period && quota > 0 && period > 0)
+        return static_cast<size_t>((quota + period - 1) / period);
+    return 0;
+}
+
+}
+
+ThreadPool::ThreadPool(size_t numThreads, std::string name)
+    : ThreadPool(Options{numThreads, numThreads, std::chrono::milliseconds(0), Affinity::NONE}, std::move(name)) {}
+
+ThreadPool::ThreadPool(const Options& options, std::string name)
+    : name(std::move(name)), minThreads(options.minThreads), maxThreads(options.maxThreads),
+      idleTimeout(options.idleTimeout), live(0), stop_flag(false) {
+    if (maxThreads == 0)
+        maxThreads = availableCpus();
+    maxThreads = std::max<size_t>(maxThreads, 1);
+    minThreads = std::min(minThreads, maxThreads);
+
+    std::vector<int> cpus = allowedCpus();
+    if (options.affinity == Affinity::CORE) {
+        for (int cpu : cpus)
+            placements.push_back({cpu});
+    } else if (options.affinity == Affinity::NUMA_NODE) {
+        placements = numaNodes(cpus);
+        // A single node would pin nothing
+        if (placements.size() < 2)
+            placements.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t i = 0; i < minThreads; ++i)
+        spawnLocked();
 }
 
 ThreadPool::~ThreadPool() {
     stop();
 }
 
+std::vector<int> ThreadPool::allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+size_t ThreadPool::availableCpus() {
+    size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    size_t allowed = allowedCpus().size();
+    if (allowed > 0)
+        cpus = std::min(cpus, allowed);
+    size_t quota = cgroupCpuLimit();
+    if (quota > 0)
+        cpus = std::min(cpus, quota);
+    return std::max<size_t>(cpus, 1);
+}
+
+size_t ThreadPool::getThreadCount() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return live;
+}
+
+size_t ThreadPool::getMaxThreads() const {
+    return maxThreads;
+}
+
 void ThreadPool::enqueue(std::function<void()> task) {
     std::lock_guard<std::mutex> lock(mtx);
     if (stop_flag) {
         throw std::runtime_error("enqueue on stopped ThreadPool");
     }
-    tasks.emplace(std::move(task));
-    cv.notify_one();
+    tasks.push({std::move(task), Trace::Clock::now(), Trace::currentRequest()});
+
+    if (!idle.empty()) {
+        // The most recently parked worker has the warmest cache
+        Worker* worker = idle.back();
+        idle.pop_back();
+        worker->parked = false;
+        worker->wake.release();
+    } else if (live < maxThreads && tasks.size() >= live) {
+        // Everyone is busy and the backlog keeps up with them
+        spawnLocked();
+    }
+}
+
+void ThreadPool::spawnLocked() {
+    joinExitedLocked();
+    std::vector<bool> taken(workers.size() + 1, false);
+    for (const auto& worker : workers)
+        if (worker->slot < taken.size())
+            taken[worker->slot] = true;
+    size_t slot = std::find(taken.begin(), taken.end(), false) - taken.begin();
+
+    workers.push_back(std::make_unique<Worker>());
+    Worker* worker = workers.back().get();
+    worker->slot = slot;
+    live++;
+    worker->thread = std::thread(&ThreadPool::worker_thread, this, worker);
+}
+
+void ThreadPool::joinExitedLocked() {
+    // An exited worker no longer takes the lock, so joining it here cannot deadlock
+    for (auto it = workers.begin(); it != workers.end();) {
+        if ((*it)->exited) {
+            (*it)->thread.join();
+            it = workers.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 void ThreadPool::stop() {
+    std::vector<std::unique_ptr<Worker>> stopping;
     {
-        std::unique_lock<std::mutex> lock(mtx);
+        std::lock_guard<std::mutex> lock(mtx);
         stop_flag = true;
-        cv.notify_all();
+        for (Worker* worker : idle) {
+            worker->parked = false;
+            worker->wake.release();
+        }
+        idle.clear();
+        stopping.swap(workers);
     }
-    for (std::thread &worker : workers) {
-        if (worker.joinable()) {
-            worker.join();
+    // Workers drain the queue before they leave
+    for (auto& worker : stopping) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
         }
     }
 }
 
-void ThreadPool::worker_thread() {
+void ThreadPool::worker_thread(Worker* self) {
+    Trace::setThreadName(name + " " + std::to_string(self->slot));
+    if (!placements.empty()) {
+        const std::vector<int>& cpus = placements[self->slot % placements.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
     while (true) {
-        std::function<void()> task;
-        {
-            std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [this]() { return stop_flag || !tasks.empty(); });
-            if (stop_flag && tasks.empty()) {
-                return;
-            }
-            if (!tasks.empty()) {
-                task = std::move(tasks.front());
-                tasks.pop();
+        if (!tasks.empty()) {
+            Job task = std::move(tasks.front());
+            tasks.pop();
+            lock.unlock();
+            if (task.request && Trace::isEnabled())
+                Trace::record("pool.queued", "request", task.enqueued, Trace::Clock::now(), nullptr, 0, task.request);
+            {
+                Trace::RequestScope scope(task.request);
+                TraceSpan span("pool.run", "thread_pool", "request", static_cast<long long>(task.request));
+                task.fn();
             }
+            lock.lock();
+            continue;
         }
-        if (task) {
-            task();
+        if (stop_flag) {
+            break;
+        }
+
+        // Park until an enqueue claims us; workers at the floor never time out
+        bool mayRetire = live > minThreads && idleTimeout.count() > 0;
+        self->parked = true;
+        idle.push_back(self);
+        lock.unlock();
+        bool woken;
+        if (mayRetire) {
+            woken = self->wake.try_acquire_for(idleTimeout);
+        } else {
+            self->wake.acquire();
+            woken = true;
+        }
+        lock.lock();
+
+        if (!self->parked) {
+            // Claimed, maybe just as the wait timed out: the release is already done
+            if (!woken)
+                self->wake.acquire();
+            continue;
+        }
+        // Timed out unclaimed
+        self->parked = false;
+        idle.erase(std::find(idle.begin(), idle.end(), self));
+        if (live > minThreads && !stop_flag) {
+            break;
         }
     }
-}
\ No newline at end of file
+    live--;
+    self->exited = true;
+}
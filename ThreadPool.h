@@ -3,28 +3,96 @@
 
 #include <thread>
 #include <mutex>
-#include <condition_variable>
+#include <semaphore>
 #include <vector>
 #include <queue>
 #include <functional>
 #include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <chrono>
+#include "Trace.h"
 
+// Worker pool that sizes itself between a floor and a ceiling: a worker is added
+// when the backlog reaches one queued task per live worker, and a worker idle for
+// idleTimeout retires while more than minThreads are left. Idle workers park on
+// their own semaphore and are woken most-recently-parked first, so an enqueue wakes
+// exactly one warm worker and the rest stay asleep.
 class ThreadPool {
 public:
-    ThreadPool(size_t numThreads);
+    // Where workers run: anywhere, one per allowed core, or spread over NUMA nodes
+    // (each worker free to move within its node)
+    enum class Affinity { NONE, CORE, NUMA_NODE };
+
+    struct Options {
+        size_t minThreads = 1;
+        size_t maxThreads = 0; // 0 = availableCpus()
+        std::chrono::milliseconds idleTimeout{30000};
+        Affinity affinity = Affinity::NONE;
+    };
+
+    // Fixed size: numThreads workers, started at once and never retired.
+    // name labels the workers in traces.
+    ThreadPool(size_t numThreads, std::string name = "pool");
+    ThreadPool(const Options& options, std::string name = "pool");
     ~ThreadPool();
 
     void enqueue(std::function<void()> task);
+
+    // Enqueues a task and returns a future for its result (or exception)
+    template <typename F>
+    auto submit(F task) -> std::future<decltype(task())> {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        std::future<decltype(task())> result = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return result;
+    }
+
     void stop();
 
+    // Workers currently alive, and the most the pool will run at once
+    size_t getThreadCount();
+    size_t getMaxThreads() const;
+
+    // CPUs this process may use: hardware threads, narrowed by the affinity mask
+    // and by a cgroup (v2 or v1) CPU quota, rounded up; at least 1
+    static size_t availableCpus();
+    // Ids of the CPUs in the calling thread's affinity mask (which a cpuset cgroup
+    // narrows), ascending; empty if the mask cannot be read
+    static std::vector<int> allowedCpus();
+
 private:
-    void worker_thread();
+    struct Job {
+        std::function<void()> fn;
+        Trace::Clock::time_point enqueued;
+        uint64_t request; // Trace request of the caller, run under the same id
+    };
+
+    struct Worker {
+        std::thread thread;
+        std::binary_semaphore wake{0};
+        size_t slot;         // Lowest free number at spawn; picks the placement
+        bool parked = false; // In idle and not yet claimed by an enqueue
+        bool exited = false; // Retired; joined by the next spawn or stop
+    };
+
+    void spawnLocked();
+    void joinExitedLocked();
+    void worker_thread(Worker* self);
+
+    std::string name;
+    size_t minThreads;
+    size_t maxThreads;
+    std::chrono::milliseconds idleTimeout;
+    std::vector<std::vector<int>> placements; // CPU sets workers are pinned to, by slot; empty = unpinned
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<Worker*> idle; // Parked workers, most recently parked last
+    size_t live;
+    std::queue<Job> tasks;
 
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-    
     std::mutex mtx;
-    std::condition_variable cv;
     std::atomic<bool> stop_flag;
 };
 
@@ -0,0 +1,218 @@
+#include "Trace.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+std::atomic<bool> Trace::enabled(false);
+
+namespace {
+
+// Retired rings (of threads that have exited) kept for export; older ones are dropped
+const size_t MAX_RETIRED_RINGS = 32;
+
+struct Event {
+    const char* name;
+    const char* category;
+    const char* argName;
+    long long arg;
+    uint64_t request;
+    int64_t start;    // ns since epoch
+    int64_t duration; // ns
+};
+
+struct Ring {
+    std::mutex mtx; // Only contended while a dump copies the ring
+    std::vector<Event> events; // Allocated on the first span
+    size_t next = 0;
+    size_t count = 0;
+    int tid = 0;
+    std::string name;
+    bool retired = false;
+};
+
+struct Registry {
+    std::mutex mtx;
+    std::vector<std::shared_ptr<Ring>> rings;
+    int nextTid = 1;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+const Trace::Clock::time_point epoch = Trace::Clock::now();
+std::atomic<uint64_t> nextRequest(1);
+thread_local uint64_t currentRequestId = 0;
+
+// The calling thread's ring, registered on first use and retired when the thread exits
+struct LocalRing {
+    std::shared_ptr<Ring> ring;
+
+    ~LocalRing() {
+        if (!ring)
+            return;
+        std::lock_guard<std::mutex> lock(registry().mtx);
+        ring->retired = true;
+    }
+
+    Ring& get() {
+        if (ring)
+            return *ring;
+        ring = std::make_shared<Ring>();
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        ring->tid = reg.nextTid++;
+        size_t retired = 0;
+        for (const auto& r : reg.rings)
+            retired += r->retired;
+        for (auto it = reg.rings.begin(); retired > MAX_RETIRED_RINGS && it != reg.rings.end();) {
+            if ((*it)->retired) {
+                it = reg.rings.erase(it);
+                retired--;
+            } else {
+                ++it;
+            }
+        }
+        reg.rings.push_back(ring);
+        return *ring;
+    }
+};
+
+thread_local LocalRing localRing;
+
+void writeString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+// Microseconds with nanosecond decimals, as the trace format expects
+void writeMicros(std::ostream& out, int64_t ns) {
+    if (ns < 0) {
+        out << '-';
+        ns = -ns;
+    }
+    int64_t fraction = ns % 1000;
+    out << ns / 1000 << '.' << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10)
+        << static_cast<char>('0' + fraction % 10);
+}
+
+}
+
+void Trace::setEnabled(bool on) {
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const std::string& name) {
+    Ring& ring = localRing.get();
+    std::lock_guard<std::mutex> lock(ring.mtx);
+    ring.name = name;
+}
+
+uint64_t Trace::newRequestId() {
+    return nextRequest.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Trace::currentRequest() {
+    return currentRequestId;
+}
+
+Trace::RequestScope::RequestScope(uint64_t id) : previous(currentRequestId) {
+    currentRequestId = id;
+}
+
+Trace::RequestScope::~RequestScope() {
+    currentRequestId = previous;
+}
+
+void Trace::record(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+                   const char* argName, long long arg, uint64_t request) {
+    Ring& ring = localRing.get();
+    Event event{name, category, argName, arg, request,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()};
+    std::lock_guard<std::mutex> lock(ring.mtx);
+    if (ring.events.empty())
+        ring.events.resize(RING_EVENTS);
+    ring.events[ring.next] = event;
+    ring.next = (ring.next + 1) % RING_EVENTS;
+    if (ring.count < RING_EVENTS)
+        ring.count++;
+}
+
+size_t Trace::writeJson(std::ostream& out) {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        rings = reg.rings;
+    }
+
+    int pid = static_cast<int>(getpid());
+    size_t spans = 0;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << pid << ",\"args\":{\"name\":\"mst server\"}}";
+    for (const auto& ring : rings) {
+        // Copied so recording threads wait only for the copy, not for the output stream
+        std::vector<Event> events;
+        std::string name;
+        int tid;
+        {
+            std::lock_guard<std::mutex> lock(ring->mtx);
+            events.reserve(ring->count);
+            for (size_t i = 0; i < ring->count; ++i)
+                events.push_back(ring->events[(ring->next + RING_EVENTS - ring->count + i) % RING_EVENTS]);
+            name = ring->name;
+            tid = ring->tid;
+        }
+
+        if (!name.empty()) {
+            out << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"name\":";
+            writeString(out, name);
+            out << "}}";
+        }
+        for (const Event& event : events) {
+            // Async spans become a begin/end pair keyed by the request id
+            for (int part = 0; part < (event.request ? 2 : 1); ++part) {
+                out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"pid\":" << pid
+                    << ",\"tid\":" << tid << ",\"ts\":";
+                writeMicros(out, event.start + (part == 1 ? event.duration : 0));
+                if (!event.request) {
+                    out << ",\"ph\":\"X\",\"dur\":";
+                    writeMicros(out, event.duration);
+                } else {
+                    out << ",\"ph\":\"" << (part == 0 ? 'b' : 'e') << "\",\"id\":\"0x" << std::hex << event.request << std::dec << '"';
+                }
+                if (event.argName && part == 0)
+                    out << ",\"args\":{\"" << event.argName << "\":" << event.arg << '}';
+                out << '}';
+            }
+            spans++;
+        }
+    }
+    out << "\n]}\n";
+    return spans;
+}
+
+void Trace::clear() {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        rings = reg.rings;
+    }
+    for (const auto& ring : rings) {
+        std::lock_guard<std::mutex> lock(ring->mtx);
+        ring->next = 0;
+        ring->count = 0;
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Lightweight span tracing, exported as Chrome trace-event JSON (opens in Perfetto
+// and chrome://tracing). Finished spans go into a fixed-size ring per thread, so
+// recording never allocates after the first span and old events are overwritten
+// rather than growing memory. Tracing is off by default; while it is off a span
+// costs one relaxed load.
+//
+// Spans tagged with a request id are exported as async events on that request's
+// own track, so a request can be followed from its session through the active
+// object queue and back even when many sessions interleave on one reactor thread.
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Events kept per thread; older ones are overwritten
+    static constexpr size_t RING_EVENTS = 8192;
+
+    static void setEnabled(bool on);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Label of the calling thread in exported traces
+    static void setThreadName(const std::string& name);
+
+    // Fresh request id for async spans (never 0)
+    static uint64_t newRequestId();
+    // Request the calling thread is working for, 0 if none. Work handed to the
+    // active object or a pool inherits it.
+    static uint64_t currentRequest();
+
+    // Sets currentRequest() for the enclosing scope. Must not span a co_await:
+    // other sessions resume on the same thread.
+    class RequestScope {
+    public:
+        explicit RequestScope(uint64_t id);
+        ~RequestScope();
+        RequestScope(const RequestScope&) = delete;
+        RequestScope& operator=(const RequestScope&) = delete;
+
+    private:
+        uint64_t previous;
+    };
+
+    // Records a finished span. name, category and argName must outlive the trace
+    // (string literals); argName may be null. A non-zero request puts the span on
+    // that request's async track instead of the thread's.
+    static void record(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+                       const char* argName = nullptr, long long arg = 0, uint64_t request = 0);
+
+    // Writes every buffered event as a Chrome trace JSON object; returns the number of spans
+    static size_t writeJson(std::ostream& out);
+    // Drops every buffered event
+    static void clear();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Records the lifetime of the enclosing scope as one span, if tracing was on when it started
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category, const char* argName = nullptr, long long arg = 0, uint64_t request = 0)
+        : name(name), category(category), argName(argName), arg(arg), request(request), active(Trace::isEnabled()) {
+        if (active)
+            start = Trace::Clock::now();
+    }
+
+    ~TraceSpan() {
+        if (active)
+            Trace::record(name, category, start, Trace::Clock::now(), argName, arg, request);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // Replaces the recorded argument, e.g. once a result size is known
+    void setArg(long long value) { arg = value; }
+
+private:
+    const char* name;
+    const char* category;
+    const char* argName;
+    long long arg;
+    uint64_t request;
+    bool active;
+    Trace::Clock::time_point start;
+};
+
+#endif // TRACE_H
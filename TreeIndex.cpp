@@ -0,0 +1,557 @@
+#include "TreeIndex.h"
+#include "Trace.h"
+#include "ThreadPool.h"
+#include "ConcurrentUnionFind.h"
+#include <algorithm>
+#include <exception>
+#include <future>
+
+namespace {
+// Pairs evaluated per pass of the batched query; small enough for the scratch arrays to stay in L1
+const size_t BATCH_BLOCK = 256;
+// Smaller forests, or pools too small to repay the roughly 2.5x extra work of the
+// Euler tour layout, use the sequential DFS even when a pool is given
+const int PARALLEL_MIN_VERTICES = 1 << 16;
+const size_t PARALLEL_MIN_THREADS = 4;
+// Fewest elements worth a task, and tasks per pool worker so uneven ones balance out
+const size_t MIN_CHUNK = 1 << 14;
+const size_t CHUNKS_PER_WORKER = 4;
+// Average arcs per sublist of the parallel list ranking
+const size_t SUBLIST_ARCS = 1024;
+// Preorder positions per block of the range maximum used for the parallel diameter
+const int MAX_BLOCK = 64;
+
+// Tasks to split n elements into, at least grain per task
+size_t chunksFor(ThreadPool& pool, size_t n, size_t grain) {
+    return std::max<size_t>(1, std::min(n / grain, pool.getMaxThreads() * CHUNKS_PER_WORKER));
+}
+
+// Runs fn(chunk, begin, end) over chunks equal slices of [0, n): the first on the calling
+// thread, the rest on pool. Waits for every slice before rethrowing the first failure.
+template <typename Fn>
+void parallelFor(ThreadPool& pool, size_t n, size_t chunks, const Fn& fn) {
+    std::vector<std::future<void>> tasks;
+    for (size_t c = 1; c < chunks; ++c)
+        tasks.push_back(pool.submit([&fn, c, n, chunks]() { fn(c, n * c / chunks, n * (c + 1) / chunks); }));
+    std::exception_ptr failure;
+    try {
+        fn(0, 0, n / chunks);
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    for (auto& task : tasks) {
+        try {
+            task.get();
+        } catch (...) {
+            if (!failure)
+                failure = std::current_exception();
+        }
+    }
+    if (failure)
+        std::rethrow_exception(failure);
+}
+}
+
+TreeIndex::TreeIndex(int vertices, const std::vector<std::tuple<int, int, int>>& edges, const std::vector<int>& roots,
+                     ThreadPool* pool)
+    : vertices(vertices), parent(vertices, -1), depth(vertices, 0), component(vertices, -1),
+      tin(vertices, 0), rootDist(vertices, 0), subtreeSize(vertices, 1), totalWeight(0), diameter(0), pairCount(0),
+      averageDistance(0.0), floorLog2(vertices + 1, 0) {
+    TraceSpan span("tree_index.build", "index", "vertices", vertices);
+    if (pool && (vertices < PARALLEL_MIN_VERTICES || pool->getMaxThreads() < PARALLEL_MIN_THREADS))
+        pool = nullptr;
+
+    // Compressed adjacency (CSR) of the tree; the Euler tour also needs each arc's reverse
+    std::vector<int> offset(vertices + 1, 0);
+    for (const auto& edge : edges) {
+        offset[std::get<0>(edge) + 1]++;
+        offset[std::get<1>(edge) + 1]++;
+    }
+    for (int v = 0; v < vertices; ++v)
+        offset[v + 1] += offset[v];
+    std::vector<std::pair<int, int>> neighbors(offset[vertices]);
+    std::vector<int> twin(pool ? offset[vertices] : 0);
+    std::vector<int> fill(offset.begin(), offset.end() - 1);
+    for (const auto& edge : edges) {
+        int u = std::get<0>(edge);
+        int v = std::get<1>(edge);
+        int w = std::get<2>(edge);
+        int a = fill[u]++;
+        int b = fill[v]++;
+        neighbors[a] = {v, w};
+        neighbors[b] = {u, w};
+        if (pool) {
+            twin[a] = b;
+            twin[b] = a;
+        }
+    }
+    fill.clear();
+    fill.shrink_to_fit();
+
+    for (int len = 2; len <= vertices; ++len)
+        floorLog2[len] = floorLog2[len / 2] + 1;
+
+    if (pool) {
+        layoutEulerTour(offset, neighbors, twin, roots, *pool);
+        computeMetricsParallel(*pool);
+    } else {
+        layoutDepthFirst(offset, neighbors, roots);
+        computeMetrics();
+    }
+
+    int height = vertices > 0 ? floorLog2[vertices] + 1 : 0;
+    levels.resize(static_cast<size_t>(height) * vertices);
+    auto buildLevel = [this, vertices](int k, size_t begin, size_t end) {
+        if (k == 0) {
+            for (size_t i = begin; i < end; ++i)
+                levels[i] = (static_cast<uint64_t>(depth[order[i]]) << 32) | static_cast<uint32_t>(order[i]);
+            return;
+        }
+        const uint64_t* prev = &levels[static_cast<size_t>(k - 1) * vertices];
+        uint64_t* cur = &levels[static_cast<size_t>(k) * vertices];
+        size_t half = size_t(1) << (k - 1);
+        size_t last = static_cast<size_t>(vertices) + 1 - (size_t(1) << k); // Ranges must fit
+        for (size_t i = begin; i < std::min(end, last); ++i)
+            cur[i] = std::min(prev[i], prev[i + half]);
+    };
+    for (int k = 0; k < height; ++k) {
+        if (pool) {
+            parallelFor(*pool, vertices, chunksFor(*pool, vertices, MIN_CHUNK), [&buildLevel, k](size_t, size_t begin, size_t end) {
+                buildLevel(k, begin, end);
+            });
+        } else {
+            buildLevel(k, 0, vertices);
+        }
+    }
+}
+
+void TreeIndex::layoutDepthFirst(const std::vector<int>& offset, const std::vector<std::pair<int, int>>& neighbors,
+                                 const std::vector<int>& roots) {
+    // Iterative DFS from every unvisited vertex, so deep trees cannot overflow the stack
+    order.reserve(vertices);
+    std::vector<int> stack;
+    std::vector<int> starts(roots);
+    for (int v = 0; v < vertices; ++v)
+        starts.push_back(v);
+    for (int root : starts) {
+        if (component[root] != -1)
+            continue;
+        component[root] = root;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            int u = stack.back();
+            stack.pop_back();
+            tin[u] = static_cast<int>(order.size());
+            order.push_back(u);
+            for (int i = offset[u]; i < offset[u + 1]; ++i) {
+                int v = neighbors[i].first;
+                if (component[v] != -1)
+                    continue;
+                component[v] = root;
+                parent[v] = u;
+                depth[v] = depth[u] + 1;
+                rootDist[v] = rootDist[u] + neighbors[i].second;
+                stack.push_back(v);
+            }
+        }
+    }
+}
+
+void TreeIndex::layoutEulerTour(const std::vector<int>& offset, const std::vector<std::pair<int, int>>& neighbors,
+                                const std::vector<int>& twin, const std::vector<int>& roots, ThreadPool& pool) {
+    const size_t arcs = neighbors.size();
+    const size_t vertexChunks = chunksFor(pool, vertices, MIN_CHUNK);
+    const size_t arcChunks = chunksFor(pool, arcs, MIN_CHUNK);
+
+    // Trees, each named by its smallest vertex
+    ConcurrentUnionFind sets(vertices);
+    parallelFor(pool, arcs, arcChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t a = begin; a < end; ++a)
+            if (static_cast<size_t>(twin[a]) > a)
+                sets.unite(neighbors[a].first, neighbors[twin[a]].first);
+    });
+    std::vector<int> rep(vertices);
+    parallelFor(pool, vertices, vertexChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v)
+            rep[v] = sets.find(static_cast<int>(v));
+    });
+
+    // Same roots and tree order as the DFS: trees of listed roots first, then by smallest vertex
+    std::vector<int> rootOf(vertices, -1); // By representative
+    std::vector<int> trees;                // Representatives in layout order
+    for (int r : roots) {
+        if (rootOf[rep[r]] == -1) {
+            rootOf[rep[r]] = r;
+            trees.push_back(rep[r]);
+        }
+    }
+    for (int v = 0; v < vertices; ++v) {
+        if (rep[v] == v && rootOf[v] == -1) {
+            rootOf[v] = v;
+            trees.push_back(v);
+        }
+    }
+
+    // Euler tour: after arc u->v comes the arc following v->u around v. Every tree's tour
+    // is cut into a list starting at its root's first arc.
+    std::vector<int> succ(arcs);
+    parallelFor(pool, arcs, arcChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t a = begin; a < end; ++a) {
+            int v = neighbors[a].first;
+            int next = twin[a] + 1 == offset[v + 1] ? offset[v] : twin[a] + 1;
+            succ[a] = next == offset[v] && v == rootOf[rep[v]] ? -1 : next;
+        }
+    });
+
+    // List ranking by sublists: every list head and a sample of arcs start a sublist, which
+    // one task walks up to the next start. Only the chain of sublists is ranked sequentially.
+    std::vector<int> sublist(arcs, -1);
+    std::vector<int> starts;
+    for (int t : trees) {
+        int r = rootOf[t];
+        if (offset[r] < offset[r + 1]) {
+            sublist[offset[r]] = static_cast<int>(starts.size());
+            starts.push_back(offset[r]);
+        }
+    }
+    for (size_t a = 0; a < arcs; a += SUBLIST_ARCS) {
+        if (sublist[a] < 0) {
+            sublist[a] = static_cast<int>(starts.size());
+            starts.push_back(static_cast<int>(a));
+        }
+    }
+    const size_t sublists = starts.size();
+    const size_t sublistChunks = chunksFor(pool, sublists, 1);
+
+    // Pass 1: position of every arc in its tour
+    std::vector<int> rank(arcs);
+    std::vector<int> nextSublist(sublists);
+    std::vector<int> length(sublists);
+    parallelFor(pool, sublists, sublistChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            int a = starts[s];
+            int position = 0;
+            while (true) {
+                rank[a] = position++;
+                int next = succ[a];
+                // Arcs of this sublist are unclaimed until reached here; starts were claimed up front
+                if (next < 0 || sublist[next] >= 0) {
+                    nextSublist[s] = next < 0 ? -1 : sublist[next];
+                    length[s] = position;
+                    break;
+                }
+                sublist[next] = static_cast<int>(s);
+                a = next;
+            }
+        }
+    });
+    std::vector<int> sublistOffset(sublists);
+    std::vector<int> treeSize(trees.size(), 1);
+    for (size_t t = 0, h = 0; t < trees.size(); ++t) {
+        int r = rootOf[trees[t]];
+        if (offset[r] == offset[r + 1])
+            continue;
+        int total = 0;
+        for (int s = static_cast<int>(h); s >= 0; s = nextSublist[s]) {
+            sublistOffset[s] = total;
+            total += length[s];
+        }
+        treeSize[t] = total / 2 + 1;
+        h++;
+    }
+    parallelFor(pool, arcs, arcChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t a = begin; a < end; ++a)
+            rank[a] += sublistOffset[sublist[a]];
+    });
+
+    // Pass 2: prefix sums along the tour. An arc entering a child for the first time (a down
+    // arc) adds its weight, one level and one preorder position; the way back subtracts the first two.
+    std::vector<long long> sumWeight(sublists);
+    std::vector<int> sumDepth(sublists), sumDown(sublists);
+    parallelFor(pool, sublists, sublistChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            long long w = 0;
+            int d = 0, n = 0;
+            int a = starts[s];
+            for (int i = 0; i < length[s]; ++i, a = succ[a]) {
+                if (rank[a] < rank[twin[a]]) {
+                    int child = neighbors[a].first;
+                    w += neighbors[a].second;
+                    d++;
+                    n++;
+                    rootDist[child] = w;
+                    depth[child] = d;
+                    tin[child] = n;
+                } else {
+                    w -= neighbors[a].second;
+                    d--;
+                }
+            }
+            sumWeight[s] = w;
+            sumDepth[s] = d;
+            sumDown[s] = n;
+        }
+    });
+    std::vector<long long> weightOffset(sublists);
+    std::vector<int> depthOffset(sublists), downOffset(sublists);
+    std::vector<int> treeStart(vertices, 0); // By representative: preorder position of the root
+    for (size_t t = 0, h = 0, position = 0; t < trees.size(); ++t) {
+        int r = rootOf[trees[t]];
+        treeStart[trees[t]] = static_cast<int>(position);
+        tin[r] = static_cast<int>(position);
+        subtreeSize[position] = treeSize[t];
+        position += treeSize[t];
+        if (offset[r] == offset[r + 1])
+            continue;
+        long long w = 0;
+        int d = 0, n = 0;
+        for (int s = static_cast<int>(h); s >= 0; s = nextSublist[s]) {
+            weightOffset[s] = w;
+            depthOffset[s] = d;
+            downOffset[s] = n;
+            w += sumWeight[s];
+            d += sumDepth[s];
+            n += sumDown[s];
+        }
+        h++;
+    }
+    parallelFor(pool, arcs, arcChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t a = begin; a < end; ++a) {
+            int back = twin[a];
+            if (rank[a] > rank[back])
+                continue;
+            int child = neighbors[a].first;
+            int s = sublist[a];
+            rootDist[child] += weightOffset[s];
+            depth[child] += depthOffset[s];
+            tin[child] += downOffset[s] + treeStart[rep[child]];
+            parent[child] = neighbors[back].first;
+            // The tour spends two arcs on every edge below child between entering and leaving it
+            subtreeSize[tin[child]] = (rank[back] - rank[a] + 1) / 2;
+        }
+    });
+
+    order.assign(vertices, 0);
+    parallelFor(pool, vertices, vertexChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            order[tin[v]] = static_cast<int>(v);
+            component[v] = rootOf[rep[v]];
+        }
+    });
+}
+
+void TreeIndex::computeMetrics() {
+    // Parents precede children in preorder, so a reverse sweep sees every subtree
+    // complete before its parent. down[i] is the longest path from order[i] into its subtree.
+    std::vector<int> parentPos(vertices, -1);
+    std::vector<long long> upWeight(vertices, 0);
+    for (int i = 0; i < vertices; ++i) {
+        int p = parent[order[i]];
+        if (p >= 0) {
+            parentPos[i] = tin[p];
+            upWeight[i] = rootDist[order[i]] - rootDist[p];
+        }
+    }
+    std::vector<long long> down(vertices, 0);
+    for (int i = vertices - 1; i >= 0; --i) {
+        int p = parentPos[i];
+        if (p < 0)
+            continue;
+        long long through = down[i] + upWeight[i];
+        diameter = std::max(diameter, down[p] + through);
+        down[p] = std::max(down[p], through);
+        subtreeSize[p] += subtreeSize[i];
+        totalWeight += upWeight[i];
+    }
+
+    // Each tree is a contiguous run starting at its root; an edge lies on the
+    // paths of size * (treeSize - size) pairs
+    long double totalDistance = 0;
+    long long treeSize = 0;
+    for (int i = 0; i < vertices; ++i) {
+        if (parentPos[i] < 0) {
+            treeSize = subtreeSize[i];
+            pairCount += treeSize * (treeSize + 1) / 2;
+            continue;
+        }
+        long long size = subtreeSize[i];
+        totalDistance += static_cast<long double>(upWeight[i]) * size * (treeSize - size);
+    }
+    if (pairCount > 0)
+        averageDistance = static_cast<double>(totalDistance / pairCount);
+}
+
+void TreeIndex::computeMetricsParallel(ThreadPool& pool) {
+    // Root distance by preorder position, plus the maximum of every block's prefix and suffix
+    // and a sparse table over whole blocks: the deepest point of a subtree's position range is
+    // then O(1) to find, or O(MAX_BLOCK) when the range lies inside one block
+    std::vector<long long> distAt(vertices), prefixMax(vertices), suffixMax(vertices);
+    const int blocks = (vertices + MAX_BLOCK - 1) / MAX_BLOCK;
+    parallelFor(pool, blocks, chunksFor(pool, blocks, MIN_CHUNK / MAX_BLOCK), [&](size_t, size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            int first = static_cast<int>(b) * MAX_BLOCK;
+            int last = std::min(vertices, first + MAX_BLOCK);
+            for (int i = first; i < last; ++i) {
+                distAt[i] = rootDist[order[i]];
+                prefixMax[i] = i == first ? distAt[i] : std::max(prefixMax[i - 1], distAt[i]);
+            }
+            for (int i = last - 1; i >= first; --i)
+                suffixMax[i] = i == last - 1 ? distAt[i] : std::max(suffixMax[i + 1], distAt[i]);
+        }
+    });
+    const int blockHeight = floorLog2[blocks] + 1;
+    std::vector<long long> blockLevels(static_cast<size_t>(blockHeight) * blocks);
+    for (int b = 0; b < blocks; ++b)
+        blockLevels[b] = suffixMax[b * MAX_BLOCK];
+    for (int k = 1; k < blockHeight; ++k) {
+        const long long* prev = &blockLevels[static_cast<size_t>(k - 1) * blocks];
+        long long* cur = &blockLevels[static_cast<size_t>(k) * blocks];
+        for (int b = 0; b + (1 << k) <= blocks; ++b)
+            cur[b] = std::max(prev[b], prev[b + (1 << (k - 1))]);
+    }
+    auto rangeMax = [&](int l, int r) {
+        int bl = l / MAX_BLOCK;
+        int br = r / MAX_BLOCK;
+        if (bl == br)
+            return *std::max_element(distAt.begin() + l, distAt.begin() + r + 1);
+        long long m = std::max(suffixMax[l], prefixMax[r]);
+        if (bl + 1 < br) {
+            int k = floorLog2[br - bl - 1];
+            const long long* level = &blockLevels[static_cast<size_t>(k) * blocks];
+            m = std::max({m, level[bl + 1], level[br - (1 << k)]});
+        }
+        return m;
+    };
+
+    // One pass over the positions; every vertex adds its edge to the parent (weight, and
+    // size * (treeSize - size) pairs crossing it) and the longest path it is the top of
+    const size_t chunks = chunksFor(pool, vertices, MIN_CHUNK);
+    std::vector<long long> weights(chunks), pairs(chunks), longest(chunks);
+    std::vector<long double> distances(chunks);
+    parallelFor(pool, vertices, chunks, [&](size_t c, size_t begin, size_t end) {
+        long long weight = 0, pairsHere = 0, longestHere = 0;
+        long double distance = 0;
+        for (size_t i = begin; i < end; ++i) {
+            int v = order[i];
+            long long size = subtreeSize[i];
+            int p = parent[v];
+            if (p < 0) {
+                pairsHere += size * (size + 1) / 2;
+            } else {
+                long long up = rootDist[v] - rootDist[p];
+                long long treeSize = subtreeSize[tin[component[v]]];
+                weight += up;
+                distance += static_cast<long double>(up) * size * (treeSize - size);
+            }
+
+            // Children start right after v and each spans its own subtree
+            long long first = LLONG_MIN, second = LLONG_MIN;
+            for (int j = static_cast<int>(i) + 1; j < static_cast<int>(i + size); j += subtreeSize[j]) {
+                long long deepest = rangeMax(j, j + subtreeSize[j] - 1);
+                if (deepest > first) {
+                    second = first;
+                    first = deepest;
+                } else if (deepest > second) {
+                    second = deepest;
+                }
+            }
+            if (first != LLONG_MIN)
+                longestHere = std::max(longestHere, first - distAt[i]);
+            if (second != LLONG_MIN)
+                longestHere = std::max(longestHere, first + second - 2 * distAt[i]);
+        }
+        weights[c] = weight;
+        pairs[c] = pairsHere;
+        longest[c] = longestHere;
+        distances[c] = distance;
+    });
+
+    long double totalDistance = 0;
+    for (size_t c = 0; c < chunks; ++c) {
+        totalWeight += weights[c];
+        pairCount += pairs[c];
+        diameter = std::max(diameter, longest[c]);
+        totalDistance += distances[c];
+    }
+    if (pairCount > 0)
+        averageDistance = static_cast<double>(totalDistance / pairCount);
+}
+
+int TreeIndex::getVertices() const {
+    return vertices;
+}
+
+uint64_t TreeIndex::rangeMin(int l, int r) const {
+    int k = floorLog2[r - l + 1];
+    const uint64_t* level = &levels[static_cast<size_t>(k) * vertices];
+    return std::min(level[l], level[r - (1 << k) + 1]);
+}
+
+int TreeIndex::lca(int u, int v) const {
+    if (u < 0 || u >= vertices || v < 0 || v >= vertices || component[u] != component[v])
+        return -1;
+    if (u == v)
+        return u;
+    int a = std::min(tin[u], tin[v]);
+    int b = std::max(tin[u], tin[v]);
+    // The shallowest vertex strictly after the earlier one in preorder is a child of the LCA
+    return parent[static_cast<uint32_t>(rangeMin(a + 1, b))];
+}
+
+long long TreeIndex::distance(int u, int v) const {
+    int ancestor = lca(u, v);
+    if (ancestor < 0)
+        return NO_PATH;
+    return rootDist[u] + rootDist[v] - 2 * rootDist[ancestor];
+}
+
+void TreeIndex::distances(const int* xs, const int* ys, long long* out, size_t n) const {
+    // Structure-of-arrays scratch; each loop below is a straight gather/min pass
+    int a[BATCH_BLOCK], b[BATCH_BLOCK], anc[BATCH_BLOCK];
+    bool valid[BATCH_BLOCK];
+
+    for (size_t base = 0; base < n; base += BATCH_BLOCK) {
+        size_t count = std::min(BATCH_BLOCK, n - base);
+        const int* x = xs + base;
+        const int* y = ys + base;
+
+        for (size_t i = 0; i < count; ++i) {
+            valid[i] = x[i] >= 0 && x[i] < vertices && y[i] >= 0 && y[i] < vertices;
+            int xi = valid[i] ? x[i] : 0;
+            int yi = valid[i] ? y[i] : 0;
+            valid[i] = valid[i] && component[xi] == component[yi];
+            a[i] = tin[xi];
+            b[i] = tin[yi];
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            int lo = std::min(a[i], b[i]);
+            int hi = std::max(a[i], b[i]);
+            if (lo == hi) {
+                anc[i] = valid[i] ? x[i] : 0;
+                continue;
+            }
+            anc[i] = parent[static_cast<uint32_t>(rangeMin(lo + 1, hi))];
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            out[base + i] = valid[i] ? rootDist[x[i]] + rootDist[y[i]] - 2 * rootDist[anc[i]] : NO_PATH;
+        }
+    }
+}
+
+long long TreeIndex::getTotalWeight() const {
+    return totalWeight;
+}
+
+long long TreeIndex::getDiameter() const {
+    return diameter;
+}
+
+long long TreeIndex::getPairCount() const {
+    return pairCount;
+}
+
+double TreeIndex::getAverageDistance() const {
+    return averageDistance;
+}
@@ -0,0 +1,84 @@
+#ifndef TREE_INDEX_H
+#define TREE_INDEX_H
+
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+
+class ThreadPool;
+
+// Flat, solver-independent index over a solved MST (or spanning forest).
+// Vertices are laid out in DFS preorder; LCA is answered in O(1) from a sparse
+// table over that order, and path distance is rootDist[u] + rootDist[v] -
+// 2 * rootDist[lca]. Every per-vertex field lives in its own contiguous array
+// so batched queries reduce to gathers over plain arrays. Whole-tree metrics
+// are computed once, by two linear sweeps over the preorder arrays.
+//
+// Given a thread pool, large forests are laid out from an Euler tour instead:
+// the tour is list-ranked and prefix-summed in parallel sublists, which yields
+// preorder positions, depths, root distances and subtree sizes without a DFS,
+// and the metrics become parallel reductions over the preorder arrays.
+class TreeIndex {
+public:
+    // Returned by distance() for vertices in different trees; -1 is a real distance once weights go negative
+    static constexpr long long NO_PATH = LLONG_MIN;
+
+    // Each tree is rooted at the first of its vertices listed in roots, or else at
+    // its smallest vertex (LCA depends on the root; distances do not). With a pool
+    // the construction waits for tasks on it, so it must not run on one of its workers.
+    TreeIndex(int vertices, const std::vector<std::tuple<int, int, int>>& edges, const std::vector<int>& roots = {},
+              ThreadPool* pool = nullptr);
+
+    int getVertices() const;
+
+    // Lowest common ancestor, or -1 when u and v lie in different trees or either is out of range
+    int lca(int u, int v) const;
+    // MST path length, or NO_PATH when u and v lie in different trees or either is out of range
+    long long distance(int u, int v) const;
+    // distance() for n pairs at once; out-of-range vertices also yield NO_PATH
+    void distances(const int* xs, const int* ys, long long* out, size_t n) const;
+
+    // Sum of the tree edge weights
+    long long getTotalWeight() const;
+    // Longest path within any one tree (0 for a forest of single vertices)
+    long long getDiameter() const;
+    // Pairs i <= j in the same tree, self pairs included, and their mean distance
+    long long getPairCount() const;
+    double getAverageDistance() const;
+
+private:
+    // Preorder layout by iterative DFS from each tree's root
+    void layoutDepthFirst(const std::vector<int>& offset, const std::vector<std::pair<int, int>>& neighbors,
+                          const std::vector<int>& roots);
+    // The same layout, plus subtreeSize, from a parallel-ranked Euler tour; twin[a] is the reverse of arc a
+    void layoutEulerTour(const std::vector<int>& offset, const std::vector<std::pair<int, int>>& neighbors,
+                         const std::vector<int>& twin, const std::vector<int>& roots, ThreadPool& pool);
+    // Fills subtreeSize and the whole-tree metrics from the preorder arrays
+    void computeMetrics();
+    // Whole-tree metrics as parallel reductions; subtreeSize must already be filled
+    void computeMetricsParallel(ThreadPool& pool);
+    // Range minimum over preorder positions [l, r], packed as (depth << 32 | vertex)
+    uint64_t rangeMin(int l, int r) const;
+
+    int vertices;
+    std::vector<int> parent;        // -1 for tree roots
+    std::vector<int> depth;
+    std::vector<int> component;     // Tree id (its root vertex)
+    std::vector<int> tin;           // Preorder position
+    std::vector<long long> rootDist;
+    std::vector<int> order;         // Vertex at each preorder position
+    std::vector<int> subtreeSize;   // By preorder position: the subtree of order[i] spans [i, i + subtreeSize[i])
+
+    long long totalWeight;
+    long long diameter;
+    long long pairCount;
+    double averageDistance;
+
+    // levels[k * vertices + i] = min over preorder positions [i, i + 2^k)
+    std::vector<uint64_t> levels;
+    std::vector<uint8_t> floorLog2; // floor(log2(len)) for len in [1, vertices]
+};
+
+#endif // TREE_INDEX_H